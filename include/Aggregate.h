@@ -0,0 +1,36 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "CollisionEvent.h"
+#include <cstddef>
+#include <limits>
+
+/**
+ * @struct Aggregate
+ * @brief Count, sums and extrema of efficiency and restEnergyOut over a set of events.
+ *
+ * Aggregates merge, so the indexes keep one per subtree, cell or block and
+ * answer a window by merging the ones it fully covers and scanning only the
+ * partially covered boundary. Sums are doubles so that merging thousands of
+ * partial sums does not lose the float precision of the events.
+ */
+struct Aggregate {
+    size_t count = 0;
+    double sumEfficiency = 0;
+    double sumRestEnergy = 0;
+    float minEfficiency = std::numeric_limits<float>::infinity();
+    float maxEfficiency = -std::numeric_limits<float>::infinity();
+    float minRestEnergy = std::numeric_limits<float>::infinity();
+    float maxRestEnergy = -std::numeric_limits<float>::infinity();
+
+    void add(const CollisionEvent& event);
+    void merge(const Aggregate& other);
+    double meanEfficiency() const { return count ? sumEfficiency / count : 0.0; }
+    double meanRestEnergy() const { return count ? sumRestEnergy / count : 0.0; }
+    /// True when every event aggregated here lies inside [minRest, maxRest].
+    bool within(float minRest, float maxRest) const { return minRest <= minRestEnergy && maxRestEnergy <= maxRest; }
+    /// True when no event aggregated here can lie inside [minRest, maxRest].
+    bool disjoint(float minRest, float maxRest) const { return count == 0 || maxRestEnergy < minRest || minRestEnergy > maxRest; }
+};
+
+#endif // AGGREGATE_H
@@ -0,0 +1,35 @@
+#ifndef ALLOCATION_TRACKER_H
+#define ALLOCATION_TRACKER_H
+
+#include <cstddef>
+
+/**
+ * @class AllocationTracker
+ * @brief Counts the bytes live on the heap, to check memory_usage() against.
+ *
+ * Built with TRACK_ALLOCATIONS defined (the CMake option of that name),
+ * AllocationTracker.cpp replaces the global operator new and delete with
+ * versions that add and subtract the usable size of every block the
+ * allocator hands out (malloc_usable_size, _msize or malloc_size). The change
+ * in live_bytes() across building an index is what the build really took from
+ * the heap, allocator rounding included, so it is a little above the
+ * memory_usage() total the index reports. A wider gap means something the
+ * index does not account for.
+ *
+ * Memory the C library allocates directly (malloc from PDCurses, say) is not
+ * seen.
+ *
+ * Tracking is off by default: every allocation in the program would pay for
+ * it, and replacing operator new conflicts with sanitizers and other
+ * allocators. memory_usage() is the production measure; this only
+ * cross-checks it.
+ */
+class AllocationTracker {
+public:
+    /// True when built with TRACK_ALLOCATIONS.
+    static bool enabled();
+    /// Bytes allocated through operator new and not yet deleted, by all threads; 0 when not enabled().
+    static size_t live_bytes();
+};
+
+#endif // ALLOCATION_TRACKER_H
@@ -0,0 +1,81 @@
+#ifndef APPROXIMATE_INDEX_H
+#define APPROXIMATE_INDEX_H
+
+#include "Aggregate.h"
+#include "GridBucketing.h"
+#include <vector>
+
+/**
+ * @struct Estimate
+ * @brief An estimated value and the half-width of its 95% confidence interval.
+ */
+struct Estimate {
+    double value = 0;
+    double halfWidth = 0;  ///< 0 when the value is exact.
+};
+
+/**
+ * @struct ApproximateAggregate
+ * @brief Sampled answer to an aggregate query.
+ */
+struct ApproximateAggregate {
+    Estimate count;
+    Estimate meanEfficiency;
+    size_t sampled = 0;  ///< Sample rows read to produce the estimate.
+};
+
+/**
+ * @class ApproximateIndex
+ * @brief Stratified samples of a GridBucketing's cells for approximate aggregates.
+ *
+ * Each grid cell is a stratum: build() keeps its exact Aggregate and a uniform
+ * random sample of up to samplesPerCell of its events, stored in random order
+ * so that any prefix is itself a uniform sample. A window takes cells it covers
+ * whole from their aggregates exactly and estimates only the cells it cuts
+ * through from the first perCell rows of their samples. Work is bounded by the
+ * number of cells times perCell, whatever the size of the dataset.
+ *
+ * aggregate_to() refines progressively, doubling perCell until both intervals
+ * are within a relative error target or the samples are used up. A sample
+ * covering its whole cell makes that cell exact.
+ *
+ * The samples are a snapshot; rebuild after the grid is modified.
+ *
+ * Only a GridBucketing can be stratified, and the strata are exactly its
+ * cells, so the estimate is only as sharp as that grid is fine. The CLI
+ * samples the loaded grid when there is one and otherwise builds a 1-D grid
+ * over the events just for sampling; it refuses to sample an attached shared
+ * index, which holds no private events to build that grid from.
+ *
+ * Background: The boundary cells of a mass window are what an exact aggregate
+ * must scan, and with hundreds of millions of events they hold millions each.
+ */
+class ApproximateIndex {
+public:
+    explicit ApproximateIndex(size_t samplesPerCell = 1024, unsigned int seed = 42);
+    void build(const GridBucketing& grid);
+    /// Estimate from the first perCell sampled rows of each cell the window cuts through.
+    ApproximateAggregate aggregate(float minRestEnergy, float maxRestEnergy, size_t perCell) const;
+    /// Doubles perCell from 32 until both half-widths are within relativeError of their values.
+    ApproximateAggregate aggregate_to(float minRestEnergy, float maxRestEnergy, double relativeError) const;
+    /// Estimated counts of equal-width bins, as in DataStructure::histogram().
+    std::vector<Estimate> histogram(float minRestEnergy, float maxRestEnergy, size_t bins, size_t perCell) const;
+    size_t samples_per_cell() const { return samplesPerCell; }
+    /// True when both half-widths are within relativeError of their values.
+    static bool converged(const ApproximateAggregate& result, double relativeError);
+private:
+    struct SampleRow {
+        float restEnergyOut;
+        float efficiency;
+    };
+    struct Stratum {
+        Aggregate summary;               ///< Exact aggregate of the cell at build time.
+        std::vector<SampleRow> sample;   ///< Uniform sample in random order.
+    };
+
+    const size_t samplesPerCell;
+    const unsigned int seed;
+    std::vector<Stratum> strata;
+};
+
+#endif // APPROXIMATE_INDEX_H
@@ -0,0 +1,112 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Arena
+ * @brief Bump allocator over large blocks, with size-class free lists and bulk release.
+ *
+ * Allocation moves a cursor through the current block; a block is only taken
+ * from the heap when the current one is full, each new one half as large as
+ * all before it. Freed chunks go on a free list by size class and are handed out
+ * again to requests they fit, the rest of a larger chunk going back on the
+ * lists, so buffers abandoned by a growing vector are reused instead of
+ * piling up. reset() releases everything at once and keeps
+ * the largest block, so rebuilding a structure of the same size mostly reuses
+ * memory the arena already holds.
+ *
+ * Not thread-safe: a structure that fills its buffers on several threads
+ * sizes them up front.
+ *
+ * Background: Index builds allocate a node or bucket per handful of events;
+ * from the heap that is a call per allocation at build and again at teardown,
+ * and the pieces scatter across memory.
+ */
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /// Memory for bytes, aligned for any fundamental type.
+    void* allocate(size_t bytes);
+    /// Returns a chunk for reuse; bytes must be the size it was allocated with.
+    void deallocate(void* chunk, size_t bytes);
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+    /// Releases every allocation at once. Objects still in the arena are not destroyed.
+    void reset();
+    /// Bytes handed out and not yet returned or reset.
+    size_t allocated() const { return used; }
+    /// Heap bytes held: the blocks and the table of them.
+    size_t reserved() const;
+private:
+    struct FreeChunk {
+        FreeChunk* next;
+        size_t size;
+    };
+    static const size_t classCount = 8 * sizeof(size_t);
+    static const size_t searchLimit = 4;  ///< Chunks tried in the request's own class before bumping.
+
+    size_t blockSize;
+    std::vector<std::pair<std::unique_ptr<char[]>, size_t>> blocks;  ///< storage and size
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t used = 0;
+    FreeChunk* freeLists[classCount] = {};  ///< class c holds chunks of 2^c to 2^(c+1) - 1 bytes
+
+    void grow(size_t bytes);
+    /// Puts bytes at start on the free list of their class.
+    void release(char* start, size_t bytes);
+};
+
+/**
+ * @class ArenaAllocator
+ * @brief Standard allocator drawing from an Arena, or from the heap when it has none.
+ *
+ * Containers moved or swapped take their allocator along, so a buffer is
+ * always returned to the arena it came from.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator() = default;
+    explicit ArenaAllocator(Arena* arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.source()) {}
+
+    T* allocate(size_t n) {
+        if (!arena) return std::allocator<T>().allocate(n);
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+    void deallocate(T* chunk, size_t n) {
+        if (arena) arena->deallocate(chunk, n * sizeof(T));
+        else std::allocator<T>().deallocate(chunk, n);
+    }
+    Arena* source() const { return arena; }
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.source(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.source(); }
+private:
+    Arena* arena = nullptr;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // ARENA_H
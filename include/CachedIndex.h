@@ -0,0 +1,82 @@
+#ifndef CACHED_INDEX_H
+#define CACHED_INDEX_H
+
+#include "DataStructure.h"
+#include <list>
+#include <mutex>
+#include <vector>
+
+class QueryExecutor;
+
+/**
+ * @struct CacheStats
+ * @brief Lookup counters of a CachedIndex.
+ */
+struct CacheStats {
+    size_t hits = 0;       ///< Windows served from an identical cached window.
+    size_t contained = 0;  ///< Windows served by filtering a cached window containing them.
+    size_t misses = 0;     ///< Windows that went to the underlying index.
+};
+
+/**
+ * @class CachedIndex
+ * @brief LRU cache of range-query results in front of another DataStructure.
+ *
+ * Keeps the results of the most recent windows, keyed by interval. A repeated
+ * window is returned as is; a window inside a cached one is answered from
+ * the smallest cached superset instead of querying the index, and is then
+ * cached itself, so narrowing a mass window step by step never goes back to
+ * the index. Misses go to the index, or through a QueryExecutor when one is
+ * given, and evict the least recently used window beyond capacity.
+ *
+ * A superset is narrowed by binary search rather than by scanning it: a result
+ * whose runs are already in restEnergyOut order (as the sorted-column indexes
+ * return them) is searched for its first and last run, and any other result is
+ * given a key-ordered copy of its event pointers when it is cached.
+ *
+ * Cached results are views into the underlying index, so insert(), erase()
+ * and update() clear the cache once the change is forwarded. Every other
+ * query is forwarded untouched. The cache is guarded by a mutex, so concurrent
+ * queries stay safe; a miss that straddles a clear() is returned but not
+ * cached.
+ *
+ * Background: Interactive sessions zoom in on a resonance, re-querying ever
+ * narrower windows around the same mass.
+ */
+class CachedIndex : public DataStructure {
+public:
+    explicit CachedIndex(DataStructure& index, size_t capacity = 32, QueryExecutor* executor = nullptr);
+    void build(std::vector<CollisionEvent>& events) override;
+    void insert(const CollisionEvent& event) override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    /// The cache and its results; the wrapped index reports its own memory.
+    MemoryUsage memory_usage() const override;
+    std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const override;
+    CacheStats stats() const;
+    void clear();
+private:
+    struct Entry {
+        RangeQuery window;
+        QueryResult result;
+        std::vector<const CollisionEvent*> byKey;  ///< result by restEnergyOut, if its runs are not in order
+    };
+
+    DataStructure& index;
+    const size_t capacity;
+    QueryExecutor* executor;
+    mutable std::mutex mutex;          ///< Guards entries and counters.
+    mutable std::list<Entry> entries;  ///< Most recently used first.
+    mutable CacheStats counters;
+    mutable size_t generation = 0;     ///< Bumped by clear(), so misses begun before it are not cached.
+
+    void remember(Entry entry, size_t missGeneration) const;
+    static Entry makeEntry(float minRestEnergy, float maxRestEnergy, const QueryResult& result);
+    static QueryResult narrow(const Entry& superset, float minRestEnergy, float maxRestEnergy);
+};
+
+#endif // CACHED_INDEX_H
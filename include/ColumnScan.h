@@ -0,0 +1,40 @@
+#ifndef COLUMN_SCAN_H
+#define COLUMN_SCAN_H
+
+#include "DataStructure.h"
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ColumnScan
+ * @brief Unindexed access path: events in arrival order, scanned in full.
+ *
+ * Every query is one sequential pass over the restEnergyOut column, run by
+ * the vectorized kernels in ScanKernels.h, with no search structure to
+ * maintain, so its cost is flat in the window width. It is
+ * the baseline the QueryPlanner weighs the indexes against, and wins when a
+ * window covers most of the data anyway.
+ *
+ * erase() moves the last event into the freed slot, so the column stays dense.
+ */
+class ColumnScan : public DataStructure {
+public:
+    void build(std::vector<CollisionEvent>& events) override;
+    void insert(const CollisionEvent& event) override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    MemoryUsage memory_usage() const override;
+    /// The stored event with this id, or nullptr.
+    const CollisionEvent* find(int eventId) const;
+    size_t size() const { return events.size(); }
+private:
+    std::vector<CollisionEvent> events;
+    std::vector<float> keys;                    ///< restEnergyOut column of events.
+    std::unordered_map<int, size_t> positions;  ///< eventId -> position in events
+};
+
+#endif // COLUMN_SCAN_H
@@ -0,0 +1,67 @@
+#ifndef COMPOSITION_INDEX_H
+#define COMPOSITION_INDEX_H
+
+#include "Bitmap.h"
+#include "CollisionEvent.h"
+#include "ParticleCounts.h"
+#include <array>
+#include <string>
+#include <vector>
+
+/**
+ * @struct CompositionCut
+ * @brief Per-species bounds on an event's outgoing particle counts.
+ *
+ * A minimum of 0 and a maximum of -1 leave a species unconstrained, e.g.
+ * "at least 2 muons and no electrons" is atLeast(Muon, 2).atMost(Electron, 0).
+ */
+struct CompositionCut {
+    std::array<int, NumParticleTypes> minCount{};  ///< Inclusive lower bound per species.
+    std::array<int, NumParticleTypes> maxCount;    ///< Inclusive upper bound per species, -1 for none.
+
+    CompositionCut() { maxCount.fill(-1); }
+    CompositionCut& atLeast(ParticleType type, int count) { minCount[type] = count; return *this; }
+    CompositionCut& atMost(ParticleType type, int count) { maxCount[type] = count; return *this; }
+    /// True when a composition passes every bound.
+    bool matches(const ParticleCounts& counts) const {
+        for (int t = 0; t < NumParticleTypes; ++t) {
+            if (counts.counts[t] < minCount[t] || (maxCount[t] >= 0 && counts.counts[t] > maxCount[t])) return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief Parses a cut such as "muon>=2,electron=0"; the operators are >=, <= and =.
+ * @throws std::runtime_error on an unknown species or malformed term.
+ */
+CompositionCut parseCompositionCut(const std::string& text);
+
+/**
+ * @class CompositionIndex
+ * @brief Bitmap index over per-species particle counts.
+ *
+ * Range-encoded: for each species and each count n seen at load time, one Bitmap
+ * holds the ids of events with at least n of that species. Any CompositionCut is
+ * then a handful of word-parallel ANDs and AND-NOTs, and the resulting id set
+ * filters (or combines with) the range results of any DataStructure.
+ *
+ * Ids of erased events stay set, which is harmless: they never appear in a range
+ * result to be matched. Events whose outgoingParticles change need a build().
+ *
+ * Background: Lepton-rich final states (e.g. dimuon without electrons) single out
+ * Z and Higgs decay candidates within a mass window.
+ */
+class CompositionIndex {
+public:
+    void build(const std::vector<CollisionEvent>& events);
+    void insert(const CollisionEvent& event);
+    /// Ids of the events passing the cut.
+    Bitmap select(const CompositionCut& cut) const;
+    size_t size() const { return all.cardinality(); }
+private:
+    Bitmap all;  ///< every indexed event
+    std::array<std::vector<Bitmap>, NumParticleTypes> levels;  ///< levels[type][n - 1]: events with >= n of type
+};
+
+#endif // COMPOSITION_INDEX_H
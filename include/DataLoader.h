@@ -6,6 +6,16 @@
 #include <vector>
 #include <string>
 
+/**
+ * @struct EnergyRange
+ * @brief restEnergyOut bounds of a loaded dataset, used to size grids to the data.
+ */
+struct EnergyRange {
+    float minRestEnergy;  ///< Smallest restEnergyOut in GeV.
+    float maxRestEnergy;  ///< Largest restEnergyOut in GeV.
+};
+
 std::vector<CollisionEvent> loadData(const std::string& filename);
+std::vector<CollisionEvent> loadData(const std::string& filename, EnergyRange& range);
 
 #endif // DATA_LOADER_H
@@ -2,23 +2,114 @@
 #ifndef DATA_STRUCTURE_H
 #define DATA_STRUCTURE_H
 
+#include "Aggregate.h"
 #include "CollisionEvent.h"
+#include "MemoryUsage.h"
+#include "QueryResult.h"
+#include <cmath>
+#include <limits>
 #include <vector>
 
+/**
+ * @struct RangeQuery
+ * @brief One rest-energy window of a batched range query.
+ */
+struct RangeQuery {
+    float minRestEnergy;
+    float maxRestEnergy;
+};
+
 /**
  * @class DataStructure
  * @brief Abstract base class (ABC) for data structures in the project (KD-Tree and Grid-Based Bucketing).
  *
- * Defines an interface for insertion, range queries, and extremum queries,
+ * Defines an interface for insertion, deletion, range queries, and extremum queries,
  * enabling polymorphic use of k-d tree and grid-based bucketing, allowing
  * for further performance insights.
+ *
+ * build() bulk-loads a dataset, letting each index use its own bulk path (a
+ * balanced build, a trained model, a parallel bucketing) without the caller
+ * knowing the concrete type; it may reorder the given vector.
+ *
+ * erase() and update() locate events by eventId, so recalibrated events can be
+ * corrected in place instead of reloading the dataset. Both return false when
+ * the eventId is not stored.
+ *
+ * Queries answer with views into the index's storage (QueryResult) rather than
+ * copies; range_query() and range_query_ids() are conveniences on top of
+ * range_query_view() for callers that need owning copies or only the ids.
+ *
+ * range_query_batch() answers many windows at once, in input order. The default
+ * simply loops; indexes override it to share one traversal across the batch.
+ *
+ * top_k_in_range() returns the k highest-efficiency events of a window, best
+ * first, pruning with the index's subtree/cell maxima and a bounded heap (TopK)
+ * rather than sorting the window.
+ *
+ * aggregate() computes window statistics without touching the covered events:
+ * each index merges its pre-aggregated subtrees, cells or blocks and scans only
+ * the boundary. histogram() bins a window into equal-width rest-energy bins,
+ * one aggregate per bin.
+ *
+ * Thread safety: every query is const and touches no mutable state, so any
+ * number of threads may query one index at once (see QueryExecutor). insert(),
+ * erase() and update() need exclusive access and invalidate outstanding views.
+ *
+ * partition() cuts a window into disjoint sub-windows holding roughly equal
+ * numbers of events, so one wide query can be split across threads. The default
+ * bisects on aggregate() counts; indexes that know their key distribution
+ * directly override it.
+ *
+ * memory_usage() reports the bytes the index holds, split into its own
+ * structure, the stored events, their strings and side structures, so
+ * structures can be compared on memory as well as speed.
  */
 class DataStructure {
 public:
+    virtual void build(std::vector<CollisionEvent>& events) {
+        for (const CollisionEvent& event : events) insert(event);
+    }
     virtual void insert(const CollisionEvent& event) = 0;
-    virtual std::vector<CollisionEvent> range_query(float minRestEnergy, float maxRestEnergy) = 0;
-    virtual CollisionEvent find_max_efficiency() = 0;
+    virtual bool erase(int eventId) = 0;
+    virtual bool update(const CollisionEvent& event) = 0;
+    virtual QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const = 0;
+    virtual const CollisionEvent& find_max_efficiency() const = 0;
+    virtual QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const = 0;
+    virtual QueryResult top_k(size_t k) const {
+        return top_k_in_range(k, -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
+    }
+    virtual Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const = 0;
+    virtual MemoryUsage memory_usage() const = 0;
+    std::vector<size_t> histogram(float minRestEnergy, float maxRestEnergy, size_t bins) const {
+        std::vector<size_t> counts(bins);
+        float width = (maxRestEnergy - minRestEnergy) / bins;
+        for (size_t b = 0; b < bins; ++b) {
+            // Bins are half-open except the last, which closes the window
+            float lo = minRestEnergy + b * width;
+            float hi = b + 1 == bins ? maxRestEnergy
+                                     : std::nextafter(minRestEnergy + (b + 1) * width, -std::numeric_limits<float>::infinity());
+            counts[b] = aggregate(lo, hi).count;
+        }
+        return counts;
+    }
+    virtual std::vector<QueryResult> range_query_batch(const std::vector<RangeQuery>& queries) const {
+        std::vector<QueryResult> results;
+        results.reserve(queries.size());
+        for (const RangeQuery& q : queries) results.push_back(range_query_view(q.minRestEnergy, q.maxRestEnergy));
+        return results;
+    }
+    virtual std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const;
+    std::vector<CollisionEvent> range_query(float minRestEnergy, float maxRestEnergy) const {
+        return range_query_view(minRestEnergy, maxRestEnergy).materialize();
+    }
+    std::vector<int> range_query_ids(float minRestEnergy, float maxRestEnergy) const {
+        return range_query_view(minRestEnergy, maxRestEnergy).eventIds();
+    }
     virtual ~DataStructure() = default;
+protected:
+    /// Sub-windows of [minRestEnergy, maxRestEnergy] split at ascending cut keys; each cut starts a window.
+    static std::vector<RangeQuery> windowsFromCuts(float minRestEnergy, float maxRestEnergy,
+                                                   const std::vector<float>& cuts);
 };
 
 #endif // DATA_STRUCTURE_H
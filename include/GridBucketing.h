@@ -1,43 +1,163 @@
 #ifndef GRID_BUCKETING_H
 #define GRID_BUCKETING_H
 
+#include "Arena.h"
 #include "DataStructure.h"
+#include "QuantileSketch.h"
+#include "Snapshot.h"
+#include <unordered_map>
 #include <vector>
-#include <queue>
-#include <functional>
 
 /**
  * @class GridBucketing
- * @brief Grid-based bucketing with heaps for fast queries.
+ * @brief Grid-based bucketing with per-cell maxima for fast queries.
  *
- * Divides data into a grid based on energy values, using heaps for O(1) extremum
- * queries. Ideal for identifying high-efficiency events (e.g., heavy particle production).
+ * Divides data into a grid based on energy values. Each cell tracks its
+ * max-efficiency event as it is filled, and a tournament tree over the cells
+ * keeps the global maximum at its root for O(1) extremum queries. Ideal for
+ * identifying high-efficiency events (e.g., heavy particle production).
+ * top_k_in_range() uses the same per-cell maxima, scanning cells best-first
+ * until no cell's maximum can beat the k-th best event found. Cells also keep a
+ * full Aggregate, so aggregate() only scans the cells a window cuts through.
+ * They keep quantile sketches of efficiency and rest energy the same way:
+ * efficiency_quantiles() and rest_energy_quantiles() merge the sketches of the
+ * cells a window covers and add the in-window events of the cells it cuts.
+ * The grid is the only index that keeps such streaming sketches; quantiles
+ * over any other DataStructure are sketched from its range query.
+ *
+ * Cells are equal-width by default. adaptBoundaries() switches to equi-depth
+ * cells taken from sampled quantiles, and hot cells are then split at their
+ * median as inserts skew the data, so no single cell dominates a range scan.
+ * Only finite keys become edges; an outer cell holding mostly infinite keys
+ * is left whole, since no split could shrink it.
+ *
+ * The rest-energy range is a starting point, not a clamp: an insert outside it
+ * grows the range (doubling, with a rebucket, up to the largest finite floats)
+ * so outliers never pile into an edge cell.
+ *
+ * insertBulk(), which build() uses, fills the grid on several threads: each worker buckets a slice
+ * of the input into its own per-cell lists, then cells are merged in parallel,
+ * so no cell is ever written by two threads.
+ *
+ * erase() leaves a tombstone (NaN key) in the cell, and a cell is compacted
+ * once a quarter of its slots are tombstones. Counts and aggregates exclude
+ * tombstones at once. A sketch cannot forget a value, so the quantile
+ * sketches are only rebuilt on compaction and until then still hold the erased
+ * values (and both values of an updated event); windows scan a cell with
+ * tombstones instead of merging its sketches, so their quantiles never include
+ * erased values. At most a quarter of a cell's slots are scanned for nothing.
+ *
+ * partition() splits a window at column edges, balancing the live counts of
+ * the columns it spans.
+ *
+ * range_query_batch() sweeps each row once for the whole batch, so a cell shared
+ * by overlapping windows is brought into cache once rather than once per window.
+ *
+ * save_snapshot() writes the grid's geometry and each cell's live events;
+ * load_snapshot() refills the cells from it without rebucketing.
+ *
+ * Cell buffers come from the grid's Arena; a rebucket or teardown drops the
+ * cells and releases their memory at once, and insertBulk() sizes every cell
+ * before its workers start, so they never allocate.
+ *
+ * Rows bin a second attribute (GridAxis), e.g. particle multiplicity, so a
+ * rest-energy window combined with a multiplicity cut is one indexed lookup.
  *
  * Background: High efficiency may indicate quark-gluon plasma or Higgs boson events.
  */
+enum class GridAxis {
+    None,          ///< single row
+    Multiplicity,  ///< total number of outgoing particles
+    JetCount       ///< number of outgoing jets
+};
+
 struct Cell {
-    std::vector<CollisionEvent> events;  ///< bucket
-    std::priority_queue<CollisionEvent, std::vector<CollisionEvent>,                   ///< heap based on efficiency
-                        std::function<bool(CollisionEvent, CollisionEvent)>> maxHeap;
+    explicit Cell(Arena* arena = nullptr) : events(ArenaAllocator<CollisionEvent>(arena)),
+        keys(ArenaAllocator<float>(arena)), axisKeys(ArenaAllocator<float>(arena)) {}
+    ArenaVector<CollisionEvent> events;  ///< bucket
+    ArenaVector<float> keys;             ///< restEnergyOut column of events, scanned by range queries
+    ArenaVector<float> axisKeys;         ///< row-axis column of events (2-D grids only)
+    size_t maxIndex = 0;                 ///< position of the max-efficiency live event in events
+    size_t tombstones = 0;               ///< erased events awaiting compaction; their keys are NaN
+    Aggregate summary;                   ///< aggregate of the live events
+    QuantileSketch efficiencySketch;     ///< efficiency quantiles of the live events and those erased since compaction
+    QuantileSketch restEnergySketch;     ///< restEnergyOut quantiles, likewise
+
+    size_t live() const { return events.size() - tombstones; }
 };
 
 class GridBucketing : public DataStructure {
 public:
     GridBucketing(float minRestEnergy, float maxRestEnergy, size_t size = 100);
+    GridBucketing(float minRestEnergy, float maxRestEnergy, size_t size,
+                  GridAxis axis, float minAxisValue, float maxAxisValue, size_t rows);
     void insert(const CollisionEvent& event) override;
-    std::vector<CollisionEvent> range_query(float minRestEnergy, float maxRestEnergy) override;
-    CollisionEvent find_max_efficiency() override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    void build(std::vector<CollisionEvent>& events) override { insertBulk(events); }
+    void insertBulk(const std::vector<CollisionEvent>& events, unsigned int threads = 0);
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    std::vector<QueryResult> range_query_batch(const std::vector<RangeQuery>& queries) const override;
+    QueryResult range_query_2d(float minRestEnergy, float maxRestEnergy, float minAxisValue, float maxAxisValue) const;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    MemoryUsage memory_usage() const override;
+    std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const override;
+    /// Sketch of the efficiencies of the events in a rest-energy window.
+    QuantileSketch efficiency_quantiles(float minRestEnergy, float maxRestEnergy) const;
+    /// Sketch of the rest energies of the events in a rest-energy window.
+    QuantileSketch rest_energy_quantiles(float minRestEnergy, float maxRestEnergy) const;
+    const CollisionEvent& find_max_efficiency_in_row(float axisValue) const;
+    const CollisionEvent& find_max_efficiency_in_column(float restEnergy) const;
+    void adaptBoundaries(const std::vector<CollisionEvent>& events, size_t sampleSize = 4096);
+    void save_snapshot(const std::string& path, const SnapshotSource& source) const;
+    /// @throws std::runtime_error if the image is not a GridBucketing snapshot or is malformed.
+    void load_snapshot(const SnapshotImage& image);
+    size_t cellCount() const { return numRows * gridSize; }
+    /// Cell by row-major index below cellCount().
+    const Cell* cellAt(size_t flatIndex) const;
 private:
+    Arena arena;  ///< cell buffers; declared before grid, whose cells point into it
     std::vector<std::vector<Cell>> grid;
+    std::vector<size_t> tournament;  ///< winner tree over cells (row-major); index 1 is the root
+    size_t leafCount;                ///< tournament leaves, a power of two >= numRows * gridSize
     size_t numRows;
     size_t gridSize;
     float bucketRange;
-    float minKinetic;
-    float maxKinetic;
+    float rowRange;
+    GridAxis axis;
+    float minAxis;
+    float maxAxis;
     float minRest;
     float maxRest;
+    bool adaptive = false;          ///< equi-depth boundaries instead of equal-width cells
+    std::vector<float> boundaries;  ///< lower edge of each column, then maxRest (adaptive mode only)
+    size_t totalEvents = 0;
+    size_t maxGridSize;             ///< cap on the columns created by hot-cell splits
+    const size_t hotFactor = 4;     ///< a cell is hot above hotFactor times the mean cell size
+    std::unordered_map<int, float> locator;  ///< eventId -> restEnergyOut, built on first erase/update
+    bool locatorBuilt = false;
 
-    std::pair<unsigned int, unsigned int> getCellIndices(float restEnergy);
+    float axisValue(const CollisionEvent& event) const;
+    unsigned int getRow(float axisValue) const;
+    unsigned int getColumn(float restEnergy) const;
+    std::pair<unsigned int, unsigned int> getCellIndices(float restEnergy, float axisValue) const;
+    size_t winner(size_t a, size_t b) const;
+    void updateTournament(size_t flatIndex);
+    void rebuildTournament();
+    void splitColumn(size_t column);
+    void place(CollisionEvent event, float axisValue);
+    std::vector<std::pair<CollisionEvent, float>> drain();
+    void resetCells();
+    void growRange(float restEnergy);
+    /// Width of an equal-width cell over [minRest, maxRest].
+    float cellWidth() const;
+    void splitHotColumns();
+    void buildLocator();
+    QuantileSketch sketchWindow(QuantileSketch Cell::*sketch, float CollisionEvent::*field,
+                                float minRestEnergy, float maxRestEnergy) const;
+    void scanCell(const Cell& cell, bool interior, float minRestEnergy, float maxRestEnergy, QueryResult& result) const;
 };
 
 #endif // GRID_BUCKETING_H
@@ -1,10 +1,13 @@
 #ifndef KD_TREE_H
 #define KD_TREE_H
 
+#include "Arena.h"
 #include "DataStructure.h"
+#include "Snapshot.h"
 #include <memory>
 #include <vector>
 #include <algorithm>
+#include <unordered_map>
 
 /**
  * @class KDTree
@@ -13,31 +16,83 @@
  * Partitions data along kinetic and rest energy dimensions. Useful for
  * querying events in specific energy ranges, e.g., to study resonance production.
  *
+ * Erased events are only marked (their key becomes NaN) and the tree is
+ * rebuilt balanced once marked events pass a quarter of the live ones, or once
+ * inserts have doubled the tree since its last balanced build.
+ *
+ * range_query_batch() walks the tree once for the whole batch, carrying down
+ * only the windows that overlap each subtree.
+ *
+ * Every node aggregates the live events below it (Aggregate), kept exact along
+ * the insert and erase paths. aggregate() merges the subtrees a window covers
+ * whole, top_k_in_range() expands the subtree with the highest maximum
+ * first, stopping once none can beat the k-th best event, and
+ * find_max_efficiency() follows the child holding the maximum down to a leaf.
+ *
+ * save_snapshot() writes the tree shape in preorder with each leaf's live
+ * events, and load_snapshot() rebuilds the same tree from it without sorting.
+ *
+ * Nodes and leaf buckets live in the tree's Arena. A rebuild or teardown
+ * destroys the events and releases all node memory at once instead of
+ * freeing three allocations per node, and a rebuild reuses the same blocks.
+ *
  * Background: Efficient range queries help identify events with specific rest-mass
  * outputs, potentially linked to heavy particles like top quarks.
  */
 struct Node {
-    int dimension;  ///< 0: kineticEnergyIn, 1: restEnergyOut.
-    float splitValue;  ///< Splitting threshold.
-    std::vector<CollisionEvent> events;  ///< Leaf bucket.
-    std::unique_ptr<Node> left, right;  ///< Child nodes.
+    explicit Node(Arena& arena) : events(ArenaAllocator<CollisionEvent>(&arena)), keys(ArenaAllocator<float>(&arena)) {}
+    int dimension = 0;  ///< 0: kineticEnergyIn, 1: restEnergyOut.
+    float splitValue = 0;  ///< Splitting threshold.
+    ArenaVector<CollisionEvent> events;  ///< Leaf bucket.
+    ArenaVector<float> keys;  ///< restEnergyOut column of the leaf bucket; NaN marks an erased event.
+    Aggregate summary;  ///< Aggregate of the live events in the subtree.
+    Node* left = nullptr;  ///< Child nodes, owned by the tree's arena.
+    Node* right = nullptr;
 };
 
 class KDTree : public DataStructure {
 public:
     KDTree();
-    void buildBalanced(std::vector<CollisionEvent>& events);
+    ~KDTree();
+    void build(std::vector<CollisionEvent>& events) override;
     void insert(const CollisionEvent& event) override;
-    std::vector<CollisionEvent> range_query(float minRestEnergy, float maxRestEnergy) override;
-    CollisionEvent find_max_efficiency() override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    std::vector<QueryResult> range_query_batch(const std::vector<RangeQuery>& queries) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    MemoryUsage memory_usage() const override;
+    void save_snapshot(const std::string& path, const SnapshotSource& source) const;
+    /// @throws std::runtime_error if the image is not a KDTree snapshot or is malformed; the tree is then empty.
+    void load_snapshot(const SnapshotImage& image);
 private:
-    std::unique_ptr<Node> root;
+    Arena arena;  ///< nodes and leaf buckets; declared before root, which points into it
+    Node* root;
     const size_t bucketSize = 10;  ///< Max events per leaf.
+    std::unordered_map<int, float> locator;  ///< eventId -> restEnergyOut, built on first erase/update.
+    bool locatorBuilt = false;
+    size_t liveCount = 0;      ///< Events stored and not erased.
+    size_t deletedCount = 0;   ///< Erased events still marked in leaves.
+    size_t builtCount = 0;     ///< Live events at the last balanced build.
+    size_t insertedCount = 0;  ///< Inserts since the last balanced build.
 
-    std::unique_ptr<Node> buildRecursive(std::vector<CollisionEvent>& events, int depth);
+    void assign(std::vector<CollisionEvent>& events, bool take);
+    Node* buildRecursive(std::vector<CollisionEvent>& events, size_t begin, size_t end, bool take);
+    void release();
     void rangeQueryRecursive(const Node* node, float minRestEnergy, float maxRestEnergy,
-                             std::vector<CollisionEvent>& result);
-    CollisionEvent findMaxEfficiencyRecursive(const Node* node);
+                             QueryResult& result) const;
+    void rangeQueryBatchRecursive(const Node* node, const std::vector<RangeQuery>& queries,
+                                  const size_t* active, size_t count, std::vector<QueryResult>& results) const;
+    void aggregateRecursive(const Node* node, float minRestEnergy, float maxRestEnergy, Aggregate& result) const;
+    bool eraseRecursive(Node* node, int eventId, float key);
+    void splitLeaf(Node* leaf);
+    void collectLive(Node* node, std::vector<CollisionEvent>& out);
+    void buildLocator();
+    void rebuild();
+    void saveRecursive(const Node* node, SnapshotWriter& writer) const;
+    void loadRecursive(const SnapshotImage& image, size_t& offset, size_t& nextEvent, Node*& slot);
 };
 
-#endif // KD_TREE_H
\ No newline at end of file
+#endif // KD_TREE_H
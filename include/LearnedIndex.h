@@ -0,0 +1,81 @@
+#ifndef LEARNED_INDEX_H
+#define LEARNED_INDEX_H
+
+#include "DataStructure.h"
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct Segment
+ * @brief One piece of the piecewise-linear CDF model over restEnergyOut.
+ *
+ * Predicts the position of a key in the sorted column as
+ * start + slope * (key - firstKey), accurate to within the build-time error bound.
+ */
+struct Segment {
+    float firstKey;  ///< Smallest key covered by the segment.
+    float slope;     ///< Positions per GeV.
+    size_t start;    ///< Position of firstKey in the sorted column.
+};
+
+/**
+ * @class LearnedIndex
+ * @brief Learned index over the sorted restEnergyOut column.
+ *
+ * Replaces tree traversal with a piecewise-linear model of the key CDF: a lookup
+ * finds its segment, predicts a position and searches only the +/- errorBound
+ * window around it. The model costs one Segment per linear piece of the CDF,
+ * far less than a Node per ten events.
+ *
+ * Erased events are flagged in place so the key column stays sorted; they are
+ * dropped at the next retrain, which an eighth of the column being flagged forces.
+ *
+ * The column is also split into fixed blocks, each with an Aggregate, under a
+ * segment tree. aggregate() merges O(log n) tree nodes and scans only the two
+ * boundary blocks; top_k_in_range() scans blocks best-first by their maxima.
+ *
+ * Background: Rest-energy spectra are smooth once loaded, so a handful of linear
+ * pieces describe the whole distribution to within a few positions.
+ */
+class LearnedIndex : public DataStructure {
+public:
+    explicit LearnedIndex(size_t errorBound = 32);
+    void build(std::vector<CollisionEvent>& events) override;
+    void insert(const CollisionEvent& event) override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    MemoryUsage memory_usage() const override;
+    std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const override;
+    size_t segmentCount() const { return segments.size(); }
+private:
+    std::vector<CollisionEvent> events;   ///< Events sorted by restEnergyOut.
+    std::vector<float> keys;              ///< restEnergyOut column of events.
+    std::vector<Segment> segments;        ///< CDF model over keys.
+    std::vector<float> segmentKeys;       ///< firstKey column of segments, for the segment search.
+    std::vector<CollisionEvent> pending;  ///< Sorted insert buffer, merged into events when full.
+    const size_t errorBound;              ///< Max distance between predicted and true position.
+    const size_t pendingLimit = 4096;     ///< Buffered inserts before retraining.
+    const size_t blockSize = 64;          ///< Events per block aggregate.
+    std::vector<Aggregate> blockTree;     ///< Segment tree over the live events of each block; index 1 is the root.
+    size_t blockLeaves = 1;               ///< First leaf of blockTree, a power of two >= the block count.
+    size_t maxIndex = 0;                  ///< Position of the max-efficiency event in events.
+    size_t pendingMaxIndex = 0;           ///< Position of the max-efficiency event in pending.
+    std::vector<bool> erased;             ///< Flags erased events in events.
+    size_t erasedCount = 0;
+    std::unordered_map<int, float> locator;  ///< eventId -> restEnergyOut, built on first erase/update.
+    bool locatorBuilt = false;
+
+    void train();
+    void mergePending();
+    void resetPendingMax();
+    void refreshBlock(size_t block);
+    void buildLocator();
+    size_t lowerBound(float key) const;
+    size_t upperBound(float key) const;
+};
+
+#endif // LEARNED_INDEX_H
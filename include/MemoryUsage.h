@@ -0,0 +1,78 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include "CollisionEvent.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct MemoryUsage
+ * @brief Bytes an index holds, split by what they are for.
+ *
+ * Counts are of bytes requested from the allocator, unused vector capacity
+ * included; AllocationTracker measures what the allocator actually handed
+ * out, for cross-checking. Hash-map nodes are counted as a link plus the
+ * element, the layout libstdc++ and libc++ use for integer keys.
+ */
+struct MemoryUsage {
+    size_t nodes = 0;    ///< The index's own structure: the object, tree nodes, cells, segments, fences, block aggregates.
+    size_t payload = 0;  ///< Stored events and their key columns.
+    size_t strings = 0;  ///< Heap storage of the events' particle strings; short strings live inside the event.
+    size_t heaps = 0;    ///< Side structures on the heap: id locators, quantile sketches, cached results.
+
+    size_t total() const { return nodes + payload + strings + heaps; }
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+        nodes += other.nodes;
+        payload += other.payload;
+        strings += other.strings;
+        heaps += other.heaps;
+        return *this;
+    }
+};
+
+/// Heap bytes of a string; zero when it fits the string's inline buffer.
+inline size_t heapBytes(const std::string& text) {
+    auto data = reinterpret_cast<uintptr_t>(text.data()), self = reinterpret_cast<uintptr_t>(&text);
+    return data >= self && data < self + sizeof(text) ? 0 : text.capacity() + 1;
+}
+
+/// Heap bytes of a vector's buffer, spare capacity included.
+template <typename T, typename Allocator>
+size_t heapBytes(const std::vector<T, Allocator>& items) {
+    return items.capacity() * sizeof(T);
+}
+
+inline size_t heapBytes(const std::vector<bool>& flags) {
+    return flags.capacity() / CHAR_BIT;
+}
+
+template <typename Key, typename Value, typename Hash, typename Equal, typename Allocator>
+size_t heapBytes(const std::unordered_map<Key, Value, Hash, Equal, Allocator>& map) {
+    // A single bucket lives inside the map; larger bucket arrays are allocated
+    size_t buckets = map.bucket_count() > 1 ? map.bucket_count() * sizeof(void*) : 0;
+    return buckets + map.size() * (sizeof(void*) + sizeof(std::pair<const Key, Value>));
+}
+
+template <typename T, typename Allocator>
+size_t heapBytes(const std::list<T, Allocator>& items) {
+    return items.size() * (2 * sizeof(void*) + sizeof(T));
+}
+
+/// Heap bytes of an event's particle strings.
+inline size_t stringBytes(const CollisionEvent& event) {
+    return heapBytes(event.incomingParticles) + heapBytes(event.outgoingParticles);
+}
+
+template <typename Events>
+size_t stringBytes(const Events& events) {
+    size_t bytes = 0;
+    for (const CollisionEvent& event : events) bytes += stringBytes(event);
+    return bytes;
+}
+
+#endif // MEMORY_USAGE_H
@@ -0,0 +1,43 @@
+#ifndef PARTICLE_COUNTS_H
+#define PARTICLE_COUNTS_H
+
+#include <array>
+#include <string>
+
+/**
+ * @enum ParticleType
+ * @brief Final-state particle species written by parse_data.py.
+ */
+enum ParticleType { Electron, Muon, Photon, Jet, Tau, NumParticleTypes };
+
+/**
+ * @struct ParticleCounts
+ * @brief Per-species multiplicities of an event's outgoing particles.
+ */
+struct ParticleCounts {
+    std::array<int, NumParticleTypes> counts{};  ///< Indexed by ParticleType.
+
+    int total() const;
+    int operator[](ParticleType type) const { return counts[type]; }
+    bool operator==(const ParticleCounts& other) const { return counts == other.counts; }
+};
+
+/**
+ * @brief Counts the particles in a comma-separated outgoingParticles string.
+ * @param outgoingParticles e.g. "jet,jet,photon", possibly space/NUL padded.
+ * @return Counts per species; unknown names are ignored.
+ */
+ParticleCounts countParticles(const std::string& outgoingParticles);
+
+/**
+ * @brief Name of a particle species as it appears in outgoingParticles.
+ */
+const char* particleName(ParticleType type);
+
+/**
+ * @brief Canonical outgoingParticles-style spelling of a composition, species in
+ *        ParticleType order, e.g. "photon,jet,jet"; empty for no particles.
+ */
+std::string signatureName(const ParticleCounts& counts);
+
+#endif // PARTICLE_COUNTS_H
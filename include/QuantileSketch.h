@@ -0,0 +1,67 @@
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * @class QuantileSketch
+ * @brief Mergeable KLL quantile sketch over a stream of floats.
+ *
+ * Values enter level 0; when the sketch is full, the lowest level at its
+ * capacity is sorted and every other value (from a random offset) is promoted
+ * to the level above at twice the weight. Capacities shrink geometrically (factor 2/3) below the top
+ * level, so a sketch holds O(k) values however many it has seen, and a
+ * quantile is within about 1.7/k of the true rank with high probability.
+ *
+ * Sketches merge level by level, so per-cell or per-thread sketches combine
+ * into one without revisiting the data; write()/read() carry them between
+ * files. Values cannot be removed; rebuild a sketch when its data changes.
+ *
+ * GridBucketing is the only index keeping sketches as it is filled, one per
+ * cell; for the other indexes a quantile query sketches the events of a range
+ * query, which costs a pass over the window.
+ *
+ * Background: Efficiency deciles and median rest-energy outputs summarise the
+ * spectrum without sorting every event.
+ */
+class QuantileSketch {
+public:
+    explicit QuantileSketch(size_t k = 200);
+    void add(float value);
+    void merge(const QuantileSketch& other);
+    /// Value at quantile q in [0, 1]; q = 0 and q = 1 give the exact extrema.
+    /// @throws std::runtime_error if the sketch is empty.
+    float quantile(double q) const;
+    /// Values at several quantiles, sorting the retained values once.
+    std::vector<float> quantiles(const std::vector<double>& qs) const;
+    /// Estimated fraction of the values that are <= value.
+    double rank(float value) const;
+    size_t count() const { return n; }
+    size_t retained() const { return stored; }
+    /// Heap bytes held by the levels.
+    size_t heap_bytes() const;
+    void write(std::ostream& out) const;
+    /// @throws std::runtime_error on a truncated or malformed sketch.
+    static QuantileSketch read(std::istream& in);
+private:
+    size_t k;
+    size_t n = 0;
+    float minValue = std::numeric_limits<float>::infinity();
+    float maxValue = -std::numeric_limits<float>::infinity();
+    std::vector<std::vector<float>> levels;  ///< levels[h] holds values of weight 2^h, sorted above level 0
+    std::vector<size_t> capacities;          ///< capacities[h] bounds levels[h] at the current height
+    size_t stored = 0;                       ///< values held across all levels
+    size_t flushAt = 0;                      ///< sum of capacities; compaction starts when stored reaches it
+    uint64_t coin = 0x9e3779b97f4a7c15ull;   ///< xorshift state choosing compaction offsets
+
+    void grow(size_t height);
+    void compress();
+    std::vector<std::pair<float, uint64_t>> weighted() const;
+};
+
+#endif // QUANTILE_SKETCH_H
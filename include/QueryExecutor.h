@@ -0,0 +1,60 @@
+#ifndef QUERY_EXECUTOR_H
+#define QUERY_EXECUTOR_H
+
+#include "DataStructure.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class QueryExecutor
+ * @brief Fixed pool of worker threads running independent read queries in parallel.
+ *
+ * Relies on the DataStructure contract that const queries may run concurrently;
+ * the caller must not modify an index while queries against it are in flight.
+ * submit() runs any callable and hands back a future; range_query_all() fans a
+ * list of windows out over the pool, and range_query_parallel() splits a single
+ * wide window into per-worker sub-windows. Each task fills its own result, and
+ * the results are concatenated afterwards, so workers never share a buffer.
+ *
+ * Background: Several analysts scanning different mass windows of the same
+ * dataset is read-only work that scales with cores.
+ */
+class QueryExecutor {
+public:
+    explicit QueryExecutor(unsigned int threads = 0);
+    ~QueryExecutor();
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    template <typename Task>
+    auto submit(Task task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto job = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> future = job->get_future();
+        enqueue([job] { (*job)(); });
+        return future;
+    }
+    /// Runs every window as its own range query on the pool; results in input order.
+    std::vector<QueryResult> range_query_all(const DataStructure& ds, const std::vector<RangeQuery>& queries);
+    /// One range query split by ds.partition() into a sub-window per worker, joined in key order.
+    QueryResult range_query_parallel(const DataStructure& ds, float minRestEnergy, float maxRestEnergy);
+    size_t threadCount() const { return workers.size(); }
+private:
+    static const size_t minEventsPerTask = 8192;  ///< smallest share of a split query worth a task
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;  ///< FIFO of queued work
+    std::mutex jobsMutex;
+    std::condition_variable jobsReady;
+    bool stopping = false;
+
+    void enqueue(std::function<void()> job);
+    void work();
+};
+
+#endif // QUERY_EXECUTOR_H
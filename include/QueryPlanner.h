@@ -0,0 +1,118 @@
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include "CompositionIndex.h"
+#include "DataStructure.h"
+#include "SignatureIndex.h"
+#include <array>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @enum QueryKind
+ * @brief Query shapes the planner keeps separate cost models for.
+ */
+enum class QueryKind { Range, TopK, Aggregate, Extremum, NumQueryKinds };
+
+/**
+ * @enum AccessKind
+ * @brief Access paths a QueryPlanner can hold.
+ */
+enum class AccessKind { KDTree, GridBucketing, LearnedIndex, ColumnScan };
+
+/**
+ * @struct CostModel
+ * @brief Predicted query time as fixed + perRow * rows in the window, in nanoseconds.
+ */
+struct CostModel {
+    double fixed = 0;
+    double perRow = 0;
+
+    double at(double rows) const { return fixed + perRow * rows; }
+};
+
+/**
+ * @class QueryPlanner
+ * @brief Holds every index over the same events and routes each query to the cheapest.
+ *
+ * build() loads each of its access paths (by default a KDTree, a
+ * GridBucketing, a LearnedIndex and an unindexed ColumnScan), then calibrates a CostModel per access path and QueryKind by
+ * timing probe windows of growing selectivity and fitting a line through them.
+ * A query estimates its row count from an equi-width histogram of
+ * restEnergyOut and goes to the path with the lowest predicted cost; explain()
+ * names that path without running the query.
+ *
+ * composition_query() chooses between filtering a range result through the
+ * CompositionIndex bitmaps and walking the SignatureIndex posting lists of the
+ * signatures passing the cut, costed the same way.
+ *
+ * Mutations go to every path and the histogram, so all plans stay correct;
+ * the cost models are only refit by the next build(). The bitmap and signature
+ * indexes describe the events as loaded, so once mutated, composition_query()
+ * filters the range result on each event's own particles instead.
+ *
+ * Every path stores its own copy of the events in its own layout, so memory
+ * grows with the number of paths; a planner over fewer paths trades some
+ * query plans for memory. Events are located for erase() and update()
+ * through an id-to-key map rather than through any one path.
+ *
+ * Background: No single structure wins every query: the learned index answers
+ * windows as one span, the grid keeps the global maximum at its root, and a
+ * window spanning most of the spectrum leaves little for any index to prune.
+ */
+class QueryPlanner : public DataStructure {
+public:
+    /// @throws std::runtime_error if paths is empty.
+    QueryPlanner(const CompositionIndex& bitmaps, const SignatureIndex& signatures,
+                 std::vector<AccessKind> paths = {AccessKind::KDTree, AccessKind::GridBucketing,
+                                                  AccessKind::LearnedIndex, AccessKind::ColumnScan});
+    void build(std::vector<CollisionEvent>& events) override;
+    void insert(const CollisionEvent& event) override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    /// Every access path, plus the planner's histogram and locator.
+    MemoryUsage memory_usage() const override;
+    std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const override;
+    /// Range query filtered by a particle-content cut.
+    QueryResult composition_query(const CompositionCut& cut, float minRestEnergy, float maxRestEnergy) const;
+    /// Name of the access path a query of this kind over the window would use.
+    const char* explain(QueryKind kind, float minRestEnergy, float maxRestEnergy) const;
+    std::string explain_composition(const CompositionCut& cut, float minRestEnergy, float maxRestEnergy) const;
+    /// Histogram estimate of the events with restEnergyOut in the window.
+    double estimate_rows(float minRestEnergy, float maxRestEnergy) const;
+private:
+    struct AccessPath {
+        const char* name;
+        std::unique_ptr<DataStructure> index;
+        std::array<CostModel, static_cast<size_t>(QueryKind::NumQueryKinds)> cost;
+
+        CostModel& costOf(QueryKind kind) { return cost[static_cast<size_t>(kind)]; }
+        const CostModel& costOf(QueryKind kind) const { return cost[static_cast<size_t>(kind)]; }
+    };
+
+    const CompositionIndex& bitmaps;
+    const SignatureIndex& signatures;
+    std::vector<AccessKind> kinds;       ///< Access paths build() creates
+    std::vector<AccessPath> paths;
+    std::unordered_map<int, float> locator;  ///< eventId -> restEnergyOut
+    bool modified = false;               ///< Mutated since build(), so the signature index is stale
+    CostModel bitmapFilterCost;          ///< per row of the range result being filtered
+    CostModel signatureCost;             ///< per row returned from the posting lists of the signatures passing the cut
+    const size_t histogramBins = 256;
+    std::vector<size_t> histogram;       ///< events per equal-width restEnergyOut bin
+    float histogramMin = 0;
+    float binWidth = 1;
+
+    const AccessPath& choose(QueryKind kind, float minRestEnergy, float maxRestEnergy) const;
+    bool signaturesCheaper(const CompositionCut& cut, float minRestEnergy, float maxRestEnergy) const;
+    size_t bin(float restEnergy) const;
+    void calibrate(const std::vector<float>& sortedKeys);
+};
+
+#endif // QUERY_PLANNER_H
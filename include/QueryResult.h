@@ -0,0 +1,88 @@
+#ifndef QUERY_RESULT_H
+#define QUERY_RESULT_H
+
+#include "CollisionEvent.h"
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+/**
+ * @class QueryResult
+ * @brief Zero-copy view of the events matched by a query.
+ *
+ * Stores spans (pointer + length) into the index's own event storage instead of
+ * copying events; adjacent matches coalesce into one span, so a fully covered
+ * leaf or cell costs a single entry. Fields are read through the view on demand,
+ * eventIds() extracts just the ids and materialize() makes owning copies.
+ *
+ * A view is only valid until the index it came from is next modified. Indexes
+ * that decode events on demand (SharedIndex) pin the decoded storage in the
+ * view with keep(), so it outlives their own cache for as long as the view
+ * does; a result built from another's events takes its pins with keepAlive().
+ */
+class QueryResult {
+public:
+    struct Span {
+        const CollisionEvent* first;  ///< First event of a contiguous run in index storage.
+        size_t count;                 ///< Events in the run.
+    };
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = CollisionEvent;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const CollisionEvent*;
+        using reference = const CollisionEvent&;
+
+        const_iterator(const Span* span, size_t offset) : span(span), offset(offset) {}
+        reference operator*() const { return span->first[offset]; }
+        pointer operator->() const { return span->first + offset; }
+        const_iterator& operator++() {
+            if (++offset == span->count) {
+                ++span;
+                offset = 0;
+            }
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return span == other.span && offset == other.offset; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    private:
+        const Span* span;
+        size_t offset;
+    };
+
+    /// Appends a run of events, extending the last span when the run continues it.
+    void add(const CollisionEvent* first, size_t count = 1) {
+        if (count == 0) return;
+        if (!spans.empty() && spans.back().first + spans.back().count == first) {
+            spans.back().count += count;
+        } else {
+            spans.push_back({first, count});
+        }
+        total += count;
+    }
+    /// Appends other's spans and its pinned storage.
+    void append(const QueryResult& other);
+    /// Keeps storage the spans point into alive as long as this result.
+    void keep(std::shared_ptr<const void> storage) { pins.push_back(std::move(storage)); }
+    /// Shares the storage other pins, for a result holding some of its events.
+    void keepAlive(const QueryResult& other) { pins.insert(pins.end(), other.pins.begin(), other.pins.end()); }
+
+    size_t size() const { return total; }
+    bool empty() const { return total == 0; }
+    const CollisionEvent& operator[](size_t index) const;
+    const_iterator begin() const { return const_iterator(spans.data(), 0); }
+    const_iterator end() const { return const_iterator(spans.data() + spans.size(), 0); }
+    const std::vector<Span>& runs() const { return spans; }
+
+    std::vector<int> eventIds() const;
+    std::vector<CollisionEvent> materialize() const;
+private:
+    std::vector<Span> spans;
+    size_t total = 0;
+    std::vector<std::shared_ptr<const void>> pins;  ///< decoded storage the spans point into, if any
+};
+
+#endif // QUERY_RESULT_H
@@ -0,0 +1,51 @@
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Range-filter kernels over a contiguous float key column.
+ *
+ * selectInRange() writes the positions of the keys in [minKey, maxKey] to
+ * out, in ascending order, and returns how many there are; NaN keys (erased
+ * events) never match. It runs the widest kernel the CPU supports, picked
+ * once at first use: AVX-512 compares 16 keys per instruction and
+ * compress-stores the matching positions, AVX2 compares 8 and places the
+ * matches with a permutation looked up by the comparison mask, and a
+ * branch-free scalar loop covers the tail and other CPUs. out must hold
+ * count positions; count must be below 2^32.
+ *
+ * forEachInRange() runs the kernel over a column of any length in chunks
+ * small enough to keep the positions on the stack, and hands each match to
+ * a callback, which is how the indexes scan their leaves and cells. Columns
+ * shorter than one vector are tested inline instead.
+ *
+ * Background: An index narrows a window to a few leaves or cells, but those
+ * and a full scan still test every key there, and a key test is a compare
+ * the CPU can do many of at once.
+ */
+size_t selectInRange(const float* keys, size_t count, float minKey, float maxKey, uint32_t* out);
+
+/// Name of the kernel selectInRange() runs on this CPU.
+const char* scanKernelName();
+
+template <typename Emit>
+void forEachInRange(const float* keys, size_t count, float minKey, float maxKey, Emit emit) {
+    // Shorter than a vector, as KD-tree leaves are: the kernel call would cost more than the compares
+    if (count < 16) {
+        for (size_t i = 0; i < count; ++i) {
+            if (keys[i] >= minKey && keys[i] <= maxKey) emit(i);
+        }
+        return;
+    }
+    const size_t chunk = 256;
+    uint32_t hits[chunk];
+    for (size_t first = 0; first < count; first += chunk) {
+        size_t found = selectInRange(keys + first, std::min(chunk, count - first), minKey, maxKey, hits);
+        for (size_t j = 0; j < found; ++j) emit(first + hits[j]);
+    }
+}
+
+#endif // SCAN_KERNELS_H
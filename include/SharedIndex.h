@@ -0,0 +1,87 @@
+#ifndef SHARED_INDEX_H
+#define SHARED_INDEX_H
+
+#include "DataStructure.h"
+#include "Snapshot.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @class SharedIndex
+ * @brief Read-only index living in a shared-memory segment, attached by many processes.
+ *
+ * publish() sorts the events by restEnergyOut and copies them into a named
+ * shared-memory object as a snapshot image (see Snapshot.h): the event table
+ * and string pool, then a restEnergyOut and an efficiency column and one
+ * Aggregate per block of blockSize rows. Every process on the node that
+ * attaches maps the same pages read-only, so there is one copy of the data
+ * however many sessions are open, and attaching costs a mapping and a header
+ * check rather than a load and a build.
+ *
+ * Windows are located by binary search on the key column; aggregate() (and
+ * so counts) works from the columns and block aggregates alone, and
+ * top_k_in_range() and find_max_efficiency() decode only the blocks holding
+ * their candidates. Because CollisionEvent owns its strings, the events a
+ * query returns are decoded per process, a block at a time, into private
+ * storage. At most decodedLimit blocks stay cached, the oldest evicted
+ * first; a result pins the blocks it points into (QueryResult::keep()), so a
+ * wide range query's private copy is released with its result rather than
+ * held for the life of the session.
+ *
+ * Mutators throw: the segment is immutable, and a changed dataset is
+ * published again under the same name.
+ *
+ * Background: Several analysts on one node would otherwise each hold their
+ * own copy of every event and index.
+ */
+class SharedIndex : public DataStructure {
+public:
+    static const size_t blockSize = 64;  ///< Rows per block aggregate and per decoded block.
+    static const size_t defaultDecodedLimit = 1024;  ///< Cached decoded blocks, 64K events.
+
+    /// Publishes events under name, replacing an older segment of that name.
+    /// @throws std::runtime_error if the segment cannot be created.
+    static std::unique_ptr<SharedSegment> publish(const std::string& name, std::vector<CollisionEvent> events,
+                                                  const SnapshotSource& source);
+    /// Attaches read-only to a published segment.
+    /// @throws std::runtime_error if none is published, or it was built from other data.
+    SharedIndex(const std::string& name, const SnapshotSource& expected, size_t decodedLimit = defaultDecodedLimit);
+
+    /// @throws std::runtime_error always; the index is read-only.
+    void build(std::vector<CollisionEvent>& events) override;
+    void insert(const CollisionEvent& event) override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    /// Private memory only; the segment is shared and counted by none of the processes mapping it.
+    MemoryUsage memory_usage() const override;
+    std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const override;
+    size_t size() const { return count; }
+    /// Decoded blocks this process holds in its cache.
+    size_t decoded_blocks() const;
+private:
+    SnapshotImage image;
+    size_t count = 0;
+    size_t blockCount = 0;
+    const Aggregate* blocks = nullptr;      ///< in the segment
+    const float* keys = nullptr;            ///< in the segment, ascending
+    const float* efficiencies = nullptr;    ///< in the segment
+    size_t decodedLimit;                    ///< most decoded blocks cached at once
+    mutable std::mutex decodeMutex;
+    mutable std::vector<std::shared_ptr<const CollisionEvent[]>> decoded;  ///< per block, null unless cached
+    mutable std::deque<size_t> cached;       ///< blocks in decoded, oldest first
+    mutable std::unique_ptr<CollisionEvent> maxEvent;  ///< find_max_efficiency()'s answer, decoded once
+
+    size_t lowerBound(float restEnergy) const;
+    size_t upperBound(float restEnergy) const;
+    /// Rows of block b as CollisionEvents, decoding and caching them if needed.
+    std::shared_ptr<const CollisionEvent[]> block(size_t b) const;
+};
+
+#endif // SHARED_INDEX_H
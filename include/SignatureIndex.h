@@ -0,0 +1,73 @@
+#ifndef SIGNATURE_INDEX_H
+#define SIGNATURE_INDEX_H
+
+#include "Aggregate.h"
+#include "CollisionEvent.h"
+#include "CompositionIndex.h"
+#include "ParticleCounts.h"
+#include "QueryResult.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct Signature
+ * @brief One distinct particle composition and its posting list.
+ */
+struct Signature {
+    ParticleCounts counts;  ///< The interned count vector.
+    size_t first;           ///< Position of the posting list in the index's row ids.
+    size_t count;           ///< Events with this composition.
+    Aggregate summary;      ///< Efficiency and restEnergyOut statistics of those events.
+};
+
+/**
+ * @class SignatureIndex
+ * @brief Inverted index from particle composition to events.
+ *
+ * Each distinct count vector is interned once. Its posting list holds row ids
+ * into the event table the index was built from, stored contiguously and
+ * sorted by restEnergyOut, so "all 4-jet events between 80 and 100 GeV" is a
+ * hash lookup plus two binary searches. Results point into that table, which
+ * must outlive the index and keep its order; reordering or resizing it needs a
+ * build(). A DataStructure may reorder the vector it builds from, so it is
+ * given a copy of the table rather than the table itself.
+ *
+ * A CompositionCut is answered the same way, one posting list per signature
+ * passing it, which beats filtering a range result when the window is wide and
+ * the cut admits few signatures.
+ *
+ * Per-signature aggregates turn composition-by-efficiency analyses into a
+ * group-by over signatures() rather than over events.
+ *
+ * Background: A few hundred final-state signatures cover the whole dataset;
+ * multi-jet and photon-jet signatures dominate QCD production.
+ */
+class SignatureIndex {
+public:
+    void build(const std::vector<CollisionEvent>& events);
+    /// Events with exactly this composition and restEnergyOut in [minRestEnergy, maxRestEnergy].
+    QueryResult range_query(const ParticleCounts& counts, float minRestEnergy, float maxRestEnergy) const;
+    /// Events of every composition passing the cut, with restEnergyOut in the window; one span per signature.
+    QueryResult range_query(const CompositionCut& cut, float minRestEnergy, float maxRestEnergy) const;
+    /// The signature with this composition, or nullptr if no event has it.
+    const Signature* find(const ParticleCounts& counts) const;
+    const std::vector<Signature>& signatures() const { return groups; }
+private:
+    struct CountsHash {
+        size_t operator()(const ParticleCounts& c) const {
+            size_t h = 0;
+            for (int v : c.counts) h = h * 31 + static_cast<size_t>(v);
+            return h;
+        }
+    };
+    const std::vector<CollisionEvent>* table = nullptr;  ///< The events rows refers to.
+    std::vector<uint32_t> rows;        ///< Row ids grouped by signature, each group sorted by restEnergyOut.
+    std::vector<float> keys;           ///< restEnergyOut of each row.
+    std::vector<Signature> groups;     ///< In order of first appearance.
+    std::unordered_map<ParticleCounts, size_t, CountsHash> lookup;  ///< counts -> position in groups
+
+    void addWindow(const Signature& group, float minRestEnergy, float maxRestEnergy, QueryResult& result) const;
+};
+
+#endif // SIGNATURE_INDEX_H
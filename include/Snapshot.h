@@ -0,0 +1,204 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "CollisionEvent.h"
+#include "DataLoader.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a whole file (mmap, or MapViewOfFile on Windows).
+ *
+ * With sharedMemory set, path names a shared-memory object (shm_open, or a
+ * named file mapping on Windows) instead of a file.
+ */
+class MappedFile {
+public:
+    /// @throws std::runtime_error if the file cannot be opened or mapped.
+    explicit MappedFile(const std::string& path, bool sharedMemory = false);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+/**
+ * @class SharedSegment
+ * @brief A writable shared-memory object of fixed size, created by the publishing process.
+ *
+ * On POSIX the object outlives the process until remove() (shm_unlink), so
+ * later sessions attach without a publisher running; on Windows the named
+ * mapping lives as long as some process holds it open.
+ */
+class SharedSegment {
+public:
+    /// Creates the object, replacing any existing one of the same name.
+    /// @throws std::runtime_error if it cannot be created or mapped.
+    SharedSegment(const std::string& name, size_t size);
+    ~SharedSegment();
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+    char* data() { return bytes; }
+    size_t size() const { return length; }
+    static void remove(const std::string& name);
+private:
+    char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+};
+
+/**
+ * @struct SnapshotSource
+ * @brief Identity of the data file a snapshot was built from.
+ */
+struct SnapshotSource {
+    uint64_t size = 0;
+    int64_t modified = 0;   ///< last write time, in the filesystem clock's ticks
+    uint64_t checksum = 0;  ///< hash of the whole file's contents
+
+    /// @throws std::runtime_error if the file cannot be read.
+    static SnapshotSource of(const std::string& path);
+    bool operator==(const SnapshotSource& other) const {
+        return size == other.size && modified == other.modified && checksum == other.checksum;
+    }
+};
+
+enum class SnapshotKind : uint32_t {
+    KDTree = 1,
+    GridBucketing = 2,
+    SharedIndex = 3
+};
+
+/// Fixed header at offset 0 of every image; section offsets are relative to it.
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    SnapshotKind kind;
+    SnapshotSource source;
+    uint64_t eventCount, eventsOffset;
+    uint64_t stringsOffset, stringsSize;
+    uint64_t recordsOffset, recordsSize;
+    uint64_t fileSize;
+};
+
+/**
+ * @class SnapshotWriter
+ * @brief Builds a snapshot image: an event table, a string pool and the index's own records.
+ *
+ * The image is relocatable: everything in it is addressed by offset from the
+ * start of the file, never by pointer, so it can be mapped at any address.
+ * Particle strings are pooled, so events with the same outgoing particles
+ * share one copy. The index appends its layout as fixed-size records, which
+ * SnapshotImage::read() returns in the same order.
+ */
+class SnapshotWriter {
+public:
+    SnapshotWriter(SnapshotKind kind, const SnapshotSource& source);
+    /// Appends an event to the table; events are numbered from 0 in the order added.
+    void add_event(const CollisionEvent& event);
+    template <typename T>
+    void add_record(const T& record) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot records must be trivially copyable");
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        records.insert(records.end(), bytes, bytes + sizeof(T));
+    }
+    /// Writes to a temporary file and renames it, so a reader never sees a partial image.
+    /// @throws std::runtime_error if the file cannot be written.
+    void write(const std::string& path) const;
+    /// Copies the image into a new shared-memory object; the header goes in last,
+    /// so a process attaching early sees no valid image rather than a partial one.
+    /// @throws std::runtime_error if the object cannot be created.
+    std::unique_ptr<SharedSegment> publish(const std::string& name) const;
+private:
+    struct EventRecord {
+        int32_t eventId;
+        uint32_t incoming;  ///< string pool offset of incomingParticles
+        uint32_t outgoing;  ///< string pool offset of outgoingParticles
+        float kineticEnergyIn;
+        float restEnergyOut;
+        float efficiency;
+    };
+    friend class SnapshotImage;
+
+    SnapshotKind kind;
+    SnapshotSource source;
+    std::vector<EventRecord> events;
+    std::vector<char> strings;  ///< uint32 length then bytes, per distinct string
+    std::unordered_map<std::string, uint32_t> pooled;
+    std::vector<char> records;
+
+    uint32_t intern(const std::string& text);
+    /// Lays out the sections and returns the header describing them.
+    SnapshotHeader layout() const;
+    /// Writes every section after the header into image, zeroing the padding.
+    void fill(char* image, const SnapshotHeader& header) const;
+};
+
+/**
+ * @class SnapshotImage
+ * @brief A snapshot mapped read-only and validated against its source data file.
+ *
+ * Opening checks the magic, version, section bounds and the recorded
+ * SnapshotSource, so a snapshot of an older data file is rejected rather than
+ * silently served. Indexes restore from the mapped records without sorting
+ * or partitioning; events are copied out because CollisionEvent owns its
+ * strings.
+ */
+class SnapshotImage {
+public:
+    /// @throws std::runtime_error if the image is missing, malformed or built from other data.
+    SnapshotImage(const std::string& path, const SnapshotSource& expected, bool sharedMemory = false);
+    SnapshotKind kind() const { return header.kind; }
+    size_t event_count() const { return header.eventCount; }
+    CollisionEvent event(size_t index) const;
+    /// All events in table order; range receives their restEnergyOut span, as loadData() does.
+    std::vector<CollisionEvent> events(EnergyRange& range) const;
+    /// Next record of the index layout; offset starts at 0 and is advanced past it.
+    /// @throws std::runtime_error when the records run out.
+    template <typename T>
+    T read(size_t& offset) const {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot records must be trivially copyable");
+        if (offset > header.recordsSize || sizeof(T) > header.recordsSize - offset)
+            throw std::runtime_error("Truncated snapshot records");
+        T record;
+        std::memcpy(&record, file.data() + header.recordsOffset + offset, sizeof(T));
+        offset += sizeof(T);
+        return record;
+    }
+    /// count records in place, starting offset bytes into the index layout.
+    /// @throws std::runtime_error if they run past the records or are misaligned.
+    template <typename T>
+    const T* view(size_t offset, size_t count) const {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot records must be trivially copyable");
+        // count comes from the file; compared by division so a huge one cannot wrap the product
+        if (offset > header.recordsSize || count > (header.recordsSize - offset) / sizeof(T) ||
+            (header.recordsOffset + offset) % alignof(T))
+            throw std::runtime_error("Malformed snapshot records");
+        return reinterpret_cast<const T*>(file.data() + header.recordsOffset + offset);
+    }
+private:
+    MappedFile file;
+    SnapshotHeader header;
+
+    std::string pooledString(uint32_t offset) const;
+};
+
+#endif // SNAPSHOT_H
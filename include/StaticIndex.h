@@ -0,0 +1,411 @@
+#ifndef STATIC_INDEX_H
+#define STATIC_INDEX_H
+
+#include "DataStructure.h"
+#include "TopK.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @struct RestEnergyKey
+ * @brief Key extractor ordering events by restEnergyOut.
+ */
+struct RestEnergyKey {
+    float operator()(const CollisionEvent& event) const { return event.restEnergyOut; }
+};
+
+/**
+ * @class StaticIndex
+ * @brief Read-mostly sorted index specialised at compile time.
+ *
+ * Payloads are sorted by KeyOf and cut into leaves of LeafSize keys; a fence
+ * column (the last key of each leaf) is binary searched to find the leaf, and
+ * the leaf itself is searched by counting keys below the bound. That count has
+ * a constant trip count and no branches, so the compiler unrolls and vectorizes
+ * it, and KeyOf is inlined rather than called through a comparator object.
+ * The key column is padded to whole leaves with +infinity so every leaf scan is
+ * full length.
+ *
+ * Nothing here is virtual; IndexAdapter puts it behind DataStructure at the
+ * menu boundary only.
+ *
+ * Background: Once loaded the dataset is queried far more than it changes, so
+ * fixing the layout at build time trades mutation cost for tighter scans.
+ */
+template <typename KeyOf = RestEnergyKey, size_t LeafSize = 16, typename Payload = CollisionEvent>
+class StaticIndex {
+public:
+    static_assert(LeafSize > 0, "LeafSize must be positive");
+    using key_extractor = KeyOf;
+    using value_type = Payload;
+    static constexpr size_t leafSize = LeafSize;
+
+    void build(std::vector<Payload> payload);
+    /// Position of the first payload whose key is >= key.
+    size_t lowerBound(float key) const;
+    /// Position of the first payload whose key is > key.
+    size_t upperBound(float key) const;
+    size_t size() const { return rows.size(); }
+    size_t leafCount() const { return fences.size(); }
+    const Payload* data() const { return rows.data(); }
+    const std::vector<Payload>& payload() const { return rows; }
+    float key(size_t position) const { return keys[position]; }
+    /// Heap bytes of the rows and key column (payload) and the fences (nodes).
+    MemoryUsage memory_usage() const;
+private:
+    std::vector<Payload> rows;  ///< Payloads sorted by KeyOf.
+    std::vector<float> keys;    ///< KeyOf column of rows, padded to whole leaves with +infinity.
+    std::vector<float> fences;  ///< Last key of each leaf.
+
+    template <bool Inclusive>
+    size_t leafRank(size_t leaf, float key) const;
+};
+
+template <typename KeyOf, size_t LeafSize, typename Payload>
+void StaticIndex<KeyOf, LeafSize, Payload>::build(std::vector<Payload> payload) {
+    KeyOf keyOf;
+    std::sort(payload.begin(), payload.end(), [&keyOf](const Payload& a, const Payload& b) {
+        return keyOf(a) < keyOf(b);
+    });
+    rows = std::move(payload);
+    size_t leaves = (rows.size() + LeafSize - 1) / LeafSize;
+    keys.assign(leaves * LeafSize, std::numeric_limits<float>::infinity());
+    fences.resize(leaves);
+    for (size_t i = 0; i < rows.size(); ++i) keys[i] = keyOf(rows[i]);
+    for (size_t leaf = 0; leaf < leaves; ++leaf) {
+        fences[leaf] = keys[std::min((leaf + 1) * LeafSize, rows.size()) - 1];
+    }
+}
+
+template <typename KeyOf, size_t LeafSize, typename Payload>
+MemoryUsage StaticIndex<KeyOf, LeafSize, Payload>::memory_usage() const {
+    MemoryUsage usage;
+    usage.nodes = heapBytes(fences);
+    usage.payload = heapBytes(rows) + heapBytes(keys);
+    return usage;
+}
+
+template <typename KeyOf, size_t LeafSize, typename Payload>
+template <bool Inclusive>
+size_t StaticIndex<KeyOf, LeafSize, Payload>::leafRank(size_t leaf, float key) const {
+    // Branch-free count over a fixed-length leaf; the padding never counts for finite keys
+    const float* leafKeys = keys.data() + leaf * LeafSize;
+    size_t rank = 0;
+    for (size_t i = 0; i < LeafSize; ++i) rank += Inclusive ? leafKeys[i] <= key : leafKeys[i] < key;
+    return std::min(leaf * LeafSize + rank, rows.size());
+}
+
+template <typename KeyOf, size_t LeafSize, typename Payload>
+size_t StaticIndex<KeyOf, LeafSize, Payload>::lowerBound(float key) const {
+    size_t leaf = std::lower_bound(fences.begin(), fences.end(), key) - fences.begin();
+    return leaf == fences.size() ? rows.size() : leafRank<false>(leaf, key);
+}
+
+template <typename KeyOf, size_t LeafSize, typename Payload>
+size_t StaticIndex<KeyOf, LeafSize, Payload>::upperBound(float key) const {
+    size_t leaf = std::upper_bound(fences.begin(), fences.end(), key) - fences.begin();
+    return leaf == fences.size() ? rows.size() : leafRank<true>(leaf, key);
+}
+
+/**
+ * @class IndexAdapter
+ * @brief DataStructure over a StaticIndex of events keyed by restEnergyOut.
+ *
+ * The only virtual layer: each query makes one virtual call here, and the
+ * searches and leaf scans below it are compiled for the concrete Index. One
+ * Aggregate per leaf serves aggregate(), top_k_in_range() and extremum queries
+ * the same way the block aggregates of LearnedIndex do.
+ *
+ * The layout is fixed at build(). Mutations go to a delta the way they do in
+ * LearnedIndex: inserts land in a sorted pending buffer that every query also
+ * searches, and erased rows are flagged in place (their leaf aggregates are
+ * recomputed) so the key column stays sorted. The buffer reaching pendingLimit
+ * or an eighth of the rows being flagged rebuilds the index once with both
+ * applied; update() is an erase plus an insert.
+ *
+ * Only the restEnergyOut-keyed CollisionEvent instantiations can be adapted,
+ * since DataStructure windows are over restEnergyOut; the leaf size is free.
+ * StaticIndex itself takes any KeyOf and Payload for use outside the menu.
+ */
+template <typename Index>
+class IndexAdapter : public DataStructure {
+public:
+    static_assert(std::is_same<typename Index::key_extractor, RestEnergyKey>::value &&
+                  std::is_same<typename Index::value_type, CollisionEvent>::value,
+                  "DataStructure windows are over the restEnergyOut of CollisionEvents");
+
+    void build(std::vector<CollisionEvent>& events) override;
+    void insert(const CollisionEvent& event) override;
+    bool erase(int eventId) override;
+    bool update(const CollisionEvent& event) override;
+    QueryResult range_query_view(float minRestEnergy, float maxRestEnergy) const override;
+    const CollisionEvent& find_max_efficiency() const override;
+    QueryResult top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const override;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const override;
+    MemoryUsage memory_usage() const override;
+    std::vector<RangeQuery> partition(float minRestEnergy, float maxRestEnergy, size_t parts) const override;
+    size_t leafCount() const { return index.leafCount(); }
+private:
+    Index index;
+    std::vector<Aggregate> leaves;        ///< Aggregate of the live rows of each leaf of index.
+    size_t maxIndex = 0;                  ///< Position of the max-efficiency live row.
+    std::vector<CollisionEvent> pending;  ///< Sorted insert buffer, merged into index when full.
+    size_t pendingMaxIndex = 0;           ///< Position of the max-efficiency event in pending.
+    const size_t pendingLimit = 4096;     ///< Buffered inserts before rebuilding.
+    std::vector<bool> erased;             ///< Flags erased rows of index.
+    size_t erasedCount = 0;
+    std::unordered_map<int, float> locator;  ///< eventId -> restEnergyOut, built on first erase/update.
+    bool locatorBuilt = false;
+
+    void reload(std::vector<CollisionEvent> events);
+    void mergePending();
+    void resetPendingMax();
+    void resetMax();
+    void refreshLeaf(size_t leaf);
+    void buildLocator();
+    /// Pending events with restEnergyOut in [minRestEnergy, maxRestEnergy].
+    std::pair<size_t, size_t> pendingWindow(float minRestEnergy, float maxRestEnergy) const;
+};
+
+/// The static index the CLI offers: restEnergyOut keys, 16-key leaves.
+using StaticRangeIndex = IndexAdapter<StaticIndex<RestEnergyKey, 16>>;
+
+template <typename Index>
+void IndexAdapter<Index>::build(std::vector<CollisionEvent>& events) {
+    pending.clear();
+    locator.clear();
+    locatorBuilt = false;
+    reload(events);
+}
+
+template <typename Index>
+void IndexAdapter<Index>::reload(std::vector<CollisionEvent> events) {
+    index.build(std::move(events));
+    const CollisionEvent* rows = index.data();
+    leaves.assign(index.leafCount(), Aggregate());
+    erased.assign(index.size(), false);
+    erasedCount = 0;
+    maxIndex = 0;
+    for (size_t i = 0; i < index.size(); ++i) {
+        leaves[i / Index::leafSize].add(rows[i]);
+        if (rows[i].efficiency > rows[maxIndex].efficiency) maxIndex = i;
+    }
+}
+
+template <typename Index>
+void IndexAdapter<Index>::mergePending() {
+    // Rebuilding is also when erased rows are finally dropped
+    std::vector<CollisionEvent> events;
+    events.reserve(index.size() - erasedCount + pending.size());
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!erased[i]) events.push_back(index.data()[i]);
+    }
+    events.insert(events.end(), std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.end()));
+    pending.clear();
+    reload(std::move(events));
+}
+
+template <typename Index>
+void IndexAdapter<Index>::resetPendingMax() {
+    pendingMaxIndex = 0;
+    for (size_t i = 1; i < pending.size(); ++i) {
+        if (pending[i].efficiency > pending[pendingMaxIndex].efficiency) pendingMaxIndex = i;
+    }
+}
+
+template <typename Index>
+void IndexAdapter<Index>::resetMax() {
+    const CollisionEvent* rows = index.data();
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!erased[i] && (erased[maxIndex] || rows[i].efficiency > rows[maxIndex].efficiency)) maxIndex = i;
+    }
+}
+
+template <typename Index>
+void IndexAdapter<Index>::refreshLeaf(size_t leaf) {
+    leaves[leaf] = Aggregate();
+    for (size_t i = leaf * Index::leafSize; i < std::min(index.size(), (leaf + 1) * Index::leafSize); ++i) {
+        if (!erased[i]) leaves[leaf].add(index.data()[i]);
+    }
+}
+
+template <typename Index>
+void IndexAdapter<Index>::buildLocator() {
+    locator.clear();
+    locator.reserve(index.size() + pending.size());
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!erased[i]) locator[index.data()[i].eventId] = index.key(i);
+    }
+    for (const CollisionEvent& e : pending) locator[e.eventId] = e.restEnergyOut;
+    locatorBuilt = true;
+}
+
+template <typename Index>
+std::pair<size_t, size_t> IndexAdapter<Index>::pendingWindow(float minRestEnergy, float maxRestEnergy) const {
+    auto lo = std::lower_bound(pending.begin(), pending.end(), minRestEnergy,
+                               [](const CollisionEvent& e, float key) { return e.restEnergyOut < key; });
+    auto hi = std::upper_bound(lo, pending.end(), maxRestEnergy,
+                               [](float key, const CollisionEvent& e) { return key < e.restEnergyOut; });
+    return {static_cast<size_t>(lo - pending.begin()), static_cast<size_t>(hi - pending.begin())};
+}
+
+template <typename Index>
+void IndexAdapter<Index>::insert(const CollisionEvent& event) {
+    auto it = std::upper_bound(pending.begin(), pending.end(), event.restEnergyOut,
+                               [](float key, const CollisionEvent& e) { return key < e.restEnergyOut; });
+    size_t pos = it - pending.begin();
+    pending.insert(it, event);
+    if (locatorBuilt) locator[event.eventId] = event.restEnergyOut;
+    if (pending.size() == 1) {
+        pendingMaxIndex = 0;
+    } else {
+        if (pos <= pendingMaxIndex) ++pendingMaxIndex;
+        if (event.efficiency > pending[pendingMaxIndex].efficiency) pendingMaxIndex = pos;
+    }
+    if (pending.size() >= pendingLimit) mergePending();
+}
+
+template <typename Index>
+bool IndexAdapter<Index>::erase(int eventId) {
+    if (!locatorBuilt) buildLocator();
+    auto it = locator.find(eventId);
+    if (it == locator.end()) return false;
+    float key = it->second;
+
+    auto [first, last] = pendingWindow(key, key);
+    for (size_t i = first; i < last; ++i) {
+        if (pending[i].eventId != eventId) continue;
+        pending.erase(pending.begin() + i);
+        resetPendingMax();
+        locator.erase(it);
+        return true;
+    }
+
+    for (size_t pos = index.lowerBound(key); pos < index.size() && index.key(pos) == key; ++pos) {
+        if (erased[pos] || index.data()[pos].eventId != eventId) continue;
+        erased[pos] = true;
+        ++erasedCount;
+        locator.erase(it);
+        if (erasedCount * 8 > index.size()) {
+            mergePending();
+            return true;
+        }
+        refreshLeaf(pos / Index::leafSize);
+        if (pos == maxIndex) resetMax();
+        return true;
+    }
+    return false;
+}
+
+template <typename Index>
+bool IndexAdapter<Index>::update(const CollisionEvent& event) {
+    if (!erase(event.eventId)) return false;
+    insert(event);
+    return true;
+}
+
+template <typename Index>
+QueryResult IndexAdapter<Index>::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    size_t lo = index.lowerBound(minRestEnergy);
+    size_t hi = index.upperBound(maxRestEnergy);
+    if (erasedCount == 0) {
+        if (lo < hi) result.add(index.data() + lo, hi - lo);
+    } else {
+        for (size_t i = lo; i < hi; ++i) {
+            if (!erased[i]) result.add(index.data() + i);
+        }
+    }
+    auto [first, last] = pendingWindow(minRestEnergy, maxRestEnergy);
+    result.add(pending.data() + first, last - first);
+    return result;
+}
+
+template <typename Index>
+const CollisionEvent& IndexAdapter<Index>::find_max_efficiency() const {
+    bool noRows = index.size() == erasedCount;
+    if (noRows && pending.empty()) throw std::runtime_error("Empty index");
+    if (noRows) return pending[pendingMaxIndex];
+    const CollisionEvent& best = index.data()[maxIndex];
+    if (pending.empty()) return best;
+    return pending[pendingMaxIndex].efficiency > best.efficiency ? pending[pendingMaxIndex] : best;
+}
+
+template <typename Index>
+Aggregate IndexAdapter<Index>::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    size_t lo = index.lowerBound(minRestEnergy);
+    size_t hi = index.upperBound(maxRestEnergy);
+    const CollisionEvent* rows = index.data();
+    // Scan the partial leaves at either end, merge the whole ones between
+    for (; lo < hi && lo % Index::leafSize != 0; ++lo) {
+        if (!erased[lo]) result.add(rows[lo]);
+    }
+    for (; lo + Index::leafSize <= hi; lo += Index::leafSize) result.merge(leaves[lo / Index::leafSize]);
+    for (; lo < hi; ++lo) {
+        if (!erased[lo]) result.add(rows[lo]);
+    }
+    auto [first, last] = pendingWindow(minRestEnergy, maxRestEnergy);
+    for (size_t i = first; i < last; ++i) result.add(pending[i]);
+    return result;
+}
+
+template <typename Index>
+QueryResult IndexAdapter<Index>::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    TopK top(k);
+    if (!(minRestEnergy <= maxRestEnergy)) return top.result();
+    size_t lo = index.lowerBound(minRestEnergy);
+    size_t hi = index.upperBound(maxRestEnergy);
+
+    // Leaves best-first by their maxima, until none can beat the k-th best event
+    using Candidate = std::pair<float, size_t>;
+    std::vector<Candidate> frontier;
+    for (size_t leaf = lo / Index::leafSize; leaf * Index::leafSize < hi; ++leaf)
+        frontier.push_back({leaves[leaf].maxEfficiency, leaf});
+    std::make_heap(frontier.begin(), frontier.end());
+    const CollisionEvent* rows = index.data();
+    while (!frontier.empty() && top.admits(frontier.front().first)) {
+        size_t leaf = frontier.front().second;
+        std::pop_heap(frontier.begin(), frontier.end());
+        frontier.pop_back();
+        size_t end = std::min(hi, (leaf + 1) * Index::leafSize);
+        for (size_t i = std::max(lo, leaf * Index::leafSize); i < end; ++i) {
+            if (!erased[i]) top.offer(&rows[i]);
+        }
+    }
+
+    // The insert buffer is small; scan its part of the window
+    auto [first, last] = pendingWindow(minRestEnergy, maxRestEnergy);
+    for (size_t i = first; i < last; ++i) top.offer(&pending[i]);
+    return top.result();
+}
+
+template <typename Index>
+MemoryUsage IndexAdapter<Index>::memory_usage() const {
+    MemoryUsage usage = index.memory_usage();
+    usage.nodes += sizeof(*this) + heapBytes(leaves) + heapBytes(erased);
+    usage.payload += heapBytes(pending);
+    usage.strings = stringBytes(index.payload()) + stringBytes(pending);
+    usage.heaps = heapBytes(locator);
+    return usage;
+}
+
+template <typename Index>
+std::vector<RangeQuery> IndexAdapter<Index>::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    if (!(minRestEnergy <= maxRestEnergy) || parts < 2) return {{minRestEnergy, maxRestEnergy}};
+    size_t first = index.lowerBound(minRestEnergy);
+    size_t last = index.upperBound(maxRestEnergy);
+    std::vector<float> cuts;
+    for (size_t p = 1; p < parts && first < last; ++p) cuts.push_back(index.key(first + (last - first) * p / parts));
+    return windowsFromCuts(minRestEnergy, maxRestEnergy, cuts);
+}
+
+#endif // STATIC_INDEX_H
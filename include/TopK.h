@@ -0,0 +1,31 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include "CollisionEvent.h"
+#include "QueryResult.h"
+#include <vector>
+
+/**
+ * @class TopK
+ * @brief Bounded min-heap keeping the k highest-efficiency events offered to it.
+ *
+ * Holds pointers into index storage, never copies. Once full, threshold() is the
+ * efficiency an event (or a whole subtree/cell whose maximum is known) must beat
+ * to matter, which is what lets the indexes prune instead of scanning.
+ */
+class TopK {
+public:
+    explicit TopK(size_t k) : k(k) { heap.reserve(k); }
+    /// True while an event of this efficiency could still enter the result.
+    bool admits(float efficiency) const {
+        return heap.size() < k || (k && efficiency > heap.front()->efficiency);
+    }
+    void offer(const CollisionEvent* event);
+    /// The kept events, highest efficiency first.
+    QueryResult result() const;
+private:
+    size_t k;
+    std::vector<const CollisionEvent*> heap;  ///< min-heap on efficiency
+};
+
+#endif // TOP_K_H
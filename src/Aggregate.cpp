@@ -0,0 +1,22 @@
+#include "Aggregate.h"
+#include <algorithm>
+
+void Aggregate::add(const CollisionEvent& event) {
+    ++count;
+    sumEfficiency += event.efficiency;
+    sumRestEnergy += event.restEnergyOut;
+    minEfficiency = std::min(minEfficiency, event.efficiency);
+    maxEfficiency = std::max(maxEfficiency, event.efficiency);
+    minRestEnergy = std::min(minRestEnergy, event.restEnergyOut);
+    maxRestEnergy = std::max(maxRestEnergy, event.restEnergyOut);
+}
+
+void Aggregate::merge(const Aggregate& other) {
+    count += other.count;
+    sumEfficiency += other.sumEfficiency;
+    sumRestEnergy += other.sumRestEnergy;
+    minEfficiency = std::min(minEfficiency, other.minEfficiency);
+    maxEfficiency = std::max(maxEfficiency, other.maxEfficiency);
+    minRestEnergy = std::min(minRestEnergy, other.minRestEnergy);
+    maxRestEnergy = std::max(maxRestEnergy, other.maxRestEnergy);
+}
@@ -0,0 +1,69 @@
+#include "AllocationTracker.h"
+
+#ifdef TRACK_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef __APPLE__
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+namespace {
+// Constant-initialized, so it is ready before any static constructor allocates
+std::atomic<size_t> liveBytes{0};
+
+size_t usableSize(void* block) {
+#if defined(_WIN32)
+    return _msize(block);
+#elif defined(__APPLE__)
+    return malloc_size(block);
+#else
+    return malloc_usable_size(block);
+#endif
+}
+}
+
+bool AllocationTracker::enabled() {
+    return true;
+}
+
+size_t AllocationTracker::live_bytes() {
+    return liveBytes.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms forward to these by default; over-aligned allocations are not counted
+void* operator new(std::size_t size) {
+    if (size == 0) size = 1;
+    void* block;
+    while (!(block = std::malloc(size))) {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+    liveBytes.fetch_add(usableSize(block), std::memory_order_relaxed);
+    return block;
+}
+
+void operator delete(void* block) noexcept {
+    if (!block) return;
+    liveBytes.fetch_sub(usableSize(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    operator delete(block);
+}
+
+#else
+
+bool AllocationTracker::enabled() {
+    return false;
+}
+
+size_t AllocationTracker::live_bytes() {
+    return 0;
+}
+
+#endif // TRACK_ALLOCATIONS
@@ -0,0 +1,116 @@
+#include "ApproximateIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace {
+const double z95 = 1.96;  ///< Two-sided 95% normal quantile.
+}
+
+ApproximateIndex::ApproximateIndex(size_t samplesPerCell, unsigned int seed) :
+    samplesPerCell(samplesPerCell), seed(seed) {}
+
+void ApproximateIndex::build(const GridBucketing& grid) {
+    std::mt19937 rng(seed);
+    strata.clear();
+    for (size_t i = 0; i < grid.cellCount(); ++i) {
+        const Cell* cell = grid.cellAt(i);
+        if (cell->summary.count == 0) continue;
+        Stratum stratum;
+        stratum.summary = cell->summary;
+        for (size_t k = 0; k < cell->events.size(); ++k) {
+            if (!std::isnan(cell->keys[k])) stratum.sample.push_back({cell->keys[k], cell->events[k].efficiency});
+        }
+        // Partial Fisher-Yates: the first samplesPerCell rows become a uniform sample in random order
+        size_t kept = std::min(samplesPerCell, stratum.sample.size());
+        for (size_t k = 0; k < kept; ++k) {
+            std::uniform_int_distribution<size_t> pick(k, stratum.sample.size() - 1);
+            std::swap(stratum.sample[k], stratum.sample[pick(rng)]);
+        }
+        stratum.sample.resize(kept);
+        stratum.sample.shrink_to_fit();
+        strata.push_back(std::move(stratum));
+    }
+}
+
+ApproximateAggregate ApproximateIndex::aggregate(float minRestEnergy, float maxRestEnergy, size_t perCell) const {
+    ApproximateAggregate result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    auto inside = [&](const SampleRow& row) {
+        return row.restEnergyOut >= minRestEnergy && row.restEnergyOut <= maxRestEnergy;
+    };
+
+    // Covered cells are exact; cut cells contribute population * sample fraction
+    double count = 0, sum = 0, countVariance = 0;
+    std::vector<const Stratum*> cut;
+    for (const Stratum& stratum : strata) {
+        if (stratum.summary.disjoint(minRestEnergy, maxRestEnergy)) continue;
+        if (stratum.summary.within(minRestEnergy, maxRestEnergy)) {
+            count += stratum.summary.count;
+            sum += stratum.summary.sumEfficiency;
+            continue;
+        }
+        size_t n = std::min(perCell, stratum.sample.size());
+        if (n == 0) continue;
+        double population = static_cast<double>(stratum.summary.count), hits = 0, hitSum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!inside(stratum.sample[i])) continue;
+            ++hits;
+            hitSum += stratum.sample[i].efficiency;
+        }
+        count += population * hits / n;
+        sum += population * hitSum / n;
+        double p = hits / n, fpc = 1.0 - n / population;
+        if (n > 1) countVariance += population * population * fpc * p * (1 - p) / (n - 1);
+        cut.push_back(&stratum);
+        result.sampled += n;
+    }
+
+    // Ratio estimator for the mean: linearised variance of in(row) * (efficiency - mean)
+    double mean = count > 0 ? sum / count : 0.0, meanVariance = 0;
+    for (const Stratum* stratum : cut) {
+        size_t n = std::min(perCell, stratum->sample.size());
+        if (n < 2) continue;
+        double population = static_cast<double>(stratum->summary.count), total = 0, squares = 0;
+        for (size_t i = 0; i < n; ++i) {
+            double d = inside(stratum->sample[i]) ? stratum->sample[i].efficiency - mean : 0.0;
+            total += d;
+            squares += d * d;
+        }
+        double variance = (squares - total * total / n) / (n - 1);
+        meanVariance += population * population * (1.0 - n / population) * variance / n;
+    }
+    if (count > 0) meanVariance /= count * count;
+
+    result.count = {count, z95 * std::sqrt(std::max(0.0, countVariance))};
+    result.meanEfficiency = {mean, z95 * std::sqrt(std::max(0.0, meanVariance))};
+    return result;
+}
+
+ApproximateAggregate ApproximateIndex::aggregate_to(float minRestEnergy, float maxRestEnergy,
+                                                    double relativeError) const {
+    for (size_t perCell = std::min<size_t>(32, samplesPerCell);; perCell *= 2) {
+        ApproximateAggregate result = aggregate(minRestEnergy, maxRestEnergy, perCell);
+        if (converged(result, relativeError) || perCell >= samplesPerCell) return result;
+    }
+}
+
+bool ApproximateIndex::converged(const ApproximateAggregate& result, double relativeError) {
+    return result.count.halfWidth <= relativeError * result.count.value &&
+           result.meanEfficiency.halfWidth <= relativeError * result.meanEfficiency.value;
+}
+
+std::vector<Estimate> ApproximateIndex::histogram(float minRestEnergy, float maxRestEnergy, size_t bins,
+                                                  size_t perCell) const {
+    std::vector<Estimate> counts(bins);
+    float width = (maxRestEnergy - minRestEnergy) / bins;
+    for (size_t b = 0; b < bins; ++b) {
+        // Half-open bins except the last, matching DataStructure::histogram()
+        float lo = minRestEnergy + b * width;
+        float hi = b + 1 == bins ? maxRestEnergy
+                                 : std::nextafter(minRestEnergy + (b + 1) * width, -std::numeric_limits<float>::infinity());
+        counts[b] = aggregate(lo, hi, perCell).count;
+    }
+    return counts;
+}
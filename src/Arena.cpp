@@ -0,0 +1,103 @@
+#include "Arena.h"
+#include <algorithm>
+
+namespace {
+const size_t granule = alignof(std::max_align_t);
+const size_t smallest = (2 * sizeof(size_t) + granule - 1) / granule * granule;  ///< room for a free-list entry
+
+size_t roundUp(size_t bytes) {
+    return std::max<size_t>(smallest, (bytes + granule - 1) / granule * granule);
+}
+
+size_t floorLog2(size_t bytes) {
+    size_t c = 0;
+    while (bytes >>= 1) ++c;
+    return c;
+}
+
+size_t ceilLog2(size_t bytes) {
+    size_t c = floorLog2(bytes);
+    return (size_t(1) << c) == bytes ? c : c + 1;
+}
+}
+
+void* Arena::allocate(size_t bytes) {
+    bytes = roundUp(bytes);
+    // Any chunk in the class above the request's fits; its own class is searched briefly before splitting larger ones
+    size_t c = ceilLog2(bytes);
+    FreeChunk* chunk = nullptr;
+    if (c < classCount && freeLists[c]) {
+        chunk = freeLists[c];
+        freeLists[c] = chunk->next;
+    } else {
+        FreeChunk** link = &freeLists[floorLog2(bytes)];
+        for (size_t tried = 0; *link && tried < searchLimit; link = &(*link)->next, ++tried) {
+            if ((*link)->size < bytes) continue;
+            chunk = *link;
+            *link = chunk->next;
+            break;
+        }
+        for (++c; !chunk && c < classCount; ++c) {
+            if (!freeLists[c]) continue;
+            chunk = freeLists[c];
+            freeLists[c] = chunk->next;
+        }
+    }
+    if (chunk) {
+        // The rest of a larger chunk goes back on the lists rather than leaving with the request
+        if (chunk->size - bytes >= smallest) release(reinterpret_cast<char*>(chunk) + bytes, chunk->size - bytes);
+        used += bytes;
+        return chunk;
+    }
+    if (static_cast<size_t>(limit - cursor) < bytes) grow(bytes);
+    void* fresh = cursor;
+    cursor += bytes;
+    used += bytes;
+    return fresh;
+}
+
+void Arena::deallocate(void* chunk, size_t bytes) {
+    bytes = roundUp(bytes);
+    used -= bytes;
+    char* start = static_cast<char*>(chunk);
+    // The latest allocation of the current block just moves the cursor back
+    if (start + bytes == cursor && start >= blocks.back().first.get()) {
+        cursor = start;
+        return;
+    }
+    release(start, bytes);
+}
+
+void Arena::release(char* start, size_t bytes) {
+    size_t c = floorLog2(bytes);
+    freeLists[c] = new (start) FreeChunk{freeLists[c], bytes};
+}
+
+void Arena::grow(size_t bytes) {
+    // The tail of the full block is still good for smaller requests
+    size_t tail = limit - cursor;
+    if (tail >= smallest) release(cursor, tail);
+    // Growing the total by half keeps the block count logarithmic and the unused tail under a third
+    size_t size = std::max({bytes, blockSize, reserved() / 2});
+    blocks.emplace_back(std::unique_ptr<char[]>(new char[size]), size);
+    cursor = blocks.back().first.get();
+    limit = cursor + size;
+}
+
+void Arena::reset() {
+    std::fill(std::begin(freeLists), std::end(freeLists), nullptr);
+    used = 0;
+    if (blocks.empty()) return;
+    auto largest = std::max_element(blocks.begin(), blocks.end(),
+                                    [](const auto& a, const auto& b) { return a.second < b.second; });
+    std::swap(blocks.front(), *largest);
+    blocks.resize(1);
+    cursor = blocks.front().first.get();
+    limit = cursor + blocks.front().second;
+}
+
+size_t Arena::reserved() const {
+    size_t total = blocks.capacity() * sizeof(blocks[0]);
+    for (const auto& block : blocks) total += block.second;
+    return total;
+}
@@ -0,0 +1,248 @@
+#include "Bitmap.h"
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+
+namespace {
+const size_t wordCount = 65536 / 64;
+
+size_t popcount(const std::vector<uint64_t>& words) {
+    size_t count = 0;
+    for (uint64_t w : words) count += std::bitset<64>(w).count();
+    return count;
+}
+
+void setBit(std::vector<uint64_t>& words, uint16_t low) {
+    words[low >> 6] |= uint64_t(1) << (low & 63);
+}
+}
+
+bool Bitmap::Container::contains(uint16_t low) const {
+    if (dense()) return (words[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+const Bitmap::Container* Bitmap::find(uint16_t key) const {
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    return (it != containers.end() && it->key == key) ? &*it : nullptr;
+}
+
+void Bitmap::normalize(Container& container) {
+    if (container.dense() && container.cardinality <= arrayLimit) {
+        container.array.clear();
+        for (size_t w = 0; w < wordCount; ++w) {
+            for (size_t bit = 0; bit < 64 && (container.words[w] >> bit); ++bit) {
+                if ((container.words[w] >> bit) & 1) container.array.push_back(static_cast<uint16_t>(w * 64 + bit));
+            }
+        }
+        container.words.clear();
+    } else if (!container.dense() && container.cardinality > arrayLimit) {
+        container.words.assign(wordCount, 0);
+        for (uint16_t low : container.array) setBit(container.words, low);
+        container.array.clear();
+    }
+}
+
+void Bitmap::add(uint32_t value) {
+    uint16_t key = value >> 16, low = value & 0xFFFF;
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        it = containers.insert(it, Container());
+        it->key = key;
+    }
+    if (it->dense()) {
+        if (!it->contains(low)) {
+            setBit(it->words, low);
+            ++it->cardinality;
+        }
+        return;
+    }
+    // Ids usually arrive in increasing order, so this is nearly always an append
+    auto pos = std::lower_bound(it->array.begin(), it->array.end(), low);
+    if (pos != it->array.end() && *pos == low) return;
+    it->array.insert(pos, low);
+    ++it->cardinality;
+    normalize(*it);
+}
+
+bool Bitmap::contains(uint32_t value) const {
+    const Container* container = find(value >> 16);
+    return container && container->contains(value & 0xFFFF);
+}
+
+size_t Bitmap::cardinality() const {
+    size_t total = 0;
+    for (const Container& c : containers) total += c.cardinality;
+    return total;
+}
+
+Bitmap::Container Bitmap::intersect(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+    if (a.dense() && b.dense()) {
+        result.words.resize(wordCount);
+        for (size_t w = 0; w < wordCount; ++w) result.words[w] = a.words[w] & b.words[w];
+        result.cardinality = popcount(result.words);
+    } else if (!a.dense() && !b.dense()) {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(result.array));
+        result.cardinality = result.array.size();
+    } else {
+        const Container& sparse = a.dense() ? b : a;
+        const Container& dense = a.dense() ? a : b;
+        for (uint16_t low : sparse.array) {
+            if (dense.contains(low)) result.array.push_back(low);
+        }
+        result.cardinality = result.array.size();
+    }
+    normalize(result);
+    return result;
+}
+
+Bitmap::Container Bitmap::unite(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+    if (a.dense() || b.dense()) {
+        result.words = a.dense() ? a.words : b.words;
+        const Container& other = a.dense() ? b : a;
+        if (other.dense()) {
+            for (size_t w = 0; w < wordCount; ++w) result.words[w] |= other.words[w];
+        } else {
+            for (uint16_t low : other.array) setBit(result.words, low);
+        }
+        result.cardinality = popcount(result.words);
+    } else {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(result.array));
+        result.cardinality = result.array.size();
+    }
+    normalize(result);
+    return result;
+}
+
+Bitmap::Container Bitmap::subtract(const Container& a, const Container& b) {
+    Container result;
+    result.key = a.key;
+    if (a.dense()) {
+        result.words = a.words;
+        if (b.dense()) {
+            for (size_t w = 0; w < wordCount; ++w) result.words[w] &= ~b.words[w];
+        } else {
+            for (uint16_t low : b.array) result.words[low >> 6] &= ~(uint64_t(1) << (low & 63));
+        }
+        result.cardinality = popcount(result.words);
+    } else if (b.dense()) {
+        for (uint16_t low : a.array) {
+            if (!b.contains(low)) result.array.push_back(low);
+        }
+        result.cardinality = result.array.size();
+    } else {
+        std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                            std::back_inserter(result.array));
+        result.cardinality = result.array.size();
+    }
+    normalize(result);
+    return result;
+}
+
+Bitmap Bitmap::operator&(const Bitmap& other) const {
+    Bitmap result;
+    auto a = containers.begin(), b = other.containers.begin();
+    while (a != containers.end() && b != other.containers.end()) {
+        if (a->key < b->key) {
+            ++a;
+        } else if (b->key < a->key) {
+            ++b;
+        } else {
+            Container c = intersect(*a++, *b++);
+            if (c.cardinality) result.containers.push_back(std::move(c));
+        }
+    }
+    return result;
+}
+
+Bitmap Bitmap::operator|(const Bitmap& other) const {
+    Bitmap result;
+    auto a = containers.begin(), b = other.containers.begin();
+    while (a != containers.end() || b != other.containers.end()) {
+        if (b == other.containers.end() || (a != containers.end() && a->key < b->key)) {
+            result.containers.push_back(*a++);
+        } else if (a == containers.end() || b->key < a->key) {
+            result.containers.push_back(*b++);
+        } else {
+            result.containers.push_back(unite(*a++, *b++));
+        }
+    }
+    return result;
+}
+
+Bitmap Bitmap::andNot(const Bitmap& other) const {
+    Bitmap result;
+    auto b = other.containers.begin();
+    for (const Container& a : containers) {
+        while (b != other.containers.end() && b->key < a.key) ++b;
+        if (b == other.containers.end() || b->key != a.key) {
+            result.containers.push_back(a);
+            continue;
+        }
+        Container c = subtract(a, *b);
+        if (c.cardinality) result.containers.push_back(std::move(c));
+    }
+    return result;
+}
+
+std::vector<uint32_t> Bitmap::values() const {
+    std::vector<uint32_t> out;
+    out.reserve(cardinality());
+    for (const Container& c : containers) {
+        uint32_t high = uint32_t(c.key) << 16;
+        if (!c.dense()) {
+            for (uint16_t low : c.array) out.push_back(high | low);
+            continue;
+        }
+        for (size_t w = 0; w < wordCount; ++w) {
+            for (size_t bit = 0; bit < 64; ++bit) {
+                if ((c.words[w] >> bit) & 1) out.push_back(high | static_cast<uint32_t>(w * 64 + bit));
+            }
+        }
+    }
+    return out;
+}
+
+QueryResult Bitmap::filter(const QueryResult& events) const {
+    QueryResult result;
+    result.keepAlive(events);
+    if (containers.empty()) return result;
+    // Probe through a bitset per container, indexed directly by key, so each event costs one word test
+    uint16_t firstKey = containers.front().key;
+    std::vector<const uint64_t*> table(containers.back().key - firstKey + 1, nullptr);
+    std::vector<std::vector<uint64_t>> expanded;
+    expanded.reserve(containers.size());
+    for (const Container& c : containers) {
+        if (c.dense()) {
+            table[c.key - firstKey] = c.words.data();
+            continue;
+        }
+        expanded.emplace_back(wordCount, 0);
+        for (uint16_t low : c.array) setBit(expanded.back(), low);
+        table[c.key - firstKey] = expanded.back().data();
+    }
+    for (const CollisionEvent& event : events) {
+        if (event.eventId < 0) continue;
+        uint32_t id = static_cast<uint32_t>(event.eventId);
+        size_t slot = (id >> 16) - firstKey;
+        if ((id >> 16) < firstKey || slot >= table.size() || !table[slot]) continue;
+        if ((table[slot][(id & 0xFFFF) >> 6] >> (id & 63)) & 1) result.add(&event);
+    }
+    return result;
+}
+
+Bitmap Bitmap::of(const QueryResult& events) {
+    Bitmap result;
+    for (const CollisionEvent& event : events) {
+        if (event.eventId >= 0) result.add(static_cast<uint32_t>(event.eventId));
+    }
+    return result;
+}
@@ -0,0 +1,167 @@
+#include "CachedIndex.h"
+#include "QueryExecutor.h"
+#include <algorithm>
+#include <limits>
+
+CachedIndex::CachedIndex(DataStructure& index, size_t capacity, QueryExecutor* executor) :
+    index(index), capacity(capacity), executor(executor) {}
+
+void CachedIndex::build(std::vector<CollisionEvent>& events) {
+    index.build(events);
+    clear();
+}
+
+void CachedIndex::insert(const CollisionEvent& event) {
+    index.insert(event);
+    clear();
+}
+
+bool CachedIndex::erase(int eventId) {
+    bool erased = index.erase(eventId);
+    clear();
+    return erased;
+}
+
+bool CachedIndex::update(const CollisionEvent& event) {
+    bool updated = index.update(event);
+    clear();
+    return updated;
+}
+
+void CachedIndex::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    ++generation;
+}
+
+CacheStats CachedIndex::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+QueryResult CachedIndex::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    if (!(minRestEnergy <= maxRestEnergy)) return QueryResult();
+    size_t missGeneration;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto superset = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            const RangeQuery& w = it->window;
+            if (w.minRestEnergy == minRestEnergy && w.maxRestEnergy == maxRestEnergy) {
+                ++counters.hits;
+                entries.splice(entries.begin(), entries, it);
+                return it->result;
+            }
+            if (w.minRestEnergy <= minRestEnergy && maxRestEnergy <= w.maxRestEnergy &&
+                (superset == entries.end() || it->result.size() < superset->result.size()))
+                superset = it;
+        }
+        if (superset != entries.end()) {
+            ++counters.contained;
+            // Narrowed results are in key order, so they need no byKey of their own
+            QueryResult result = narrow(*superset, minRestEnergy, maxRestEnergy);
+            entries.splice(entries.begin(), entries, superset);
+            entries.push_front({{minRestEnergy, maxRestEnergy}, result, {}});
+            if (entries.size() > capacity) entries.pop_back();
+            return result;
+        }
+        ++counters.misses;
+        missGeneration = generation;
+    }
+    // Query and order outside the lock so concurrent misses do not serialise on the index
+    QueryResult result = executor ? executor->range_query_parallel(index, minRestEnergy, maxRestEnergy)
+                                  : index.range_query_view(minRestEnergy, maxRestEnergy);
+    if (capacity > 0) remember(makeEntry(minRestEnergy, maxRestEnergy, result), missGeneration);
+    return result;
+}
+
+CachedIndex::Entry CachedIndex::makeEntry(float minRestEnergy, float maxRestEnergy, const QueryResult& result) {
+    Entry entry{{minRestEnergy, maxRestEnergy}, result, {}};
+    float previous = -std::numeric_limits<float>::infinity();
+    bool ordered = true;
+    for (const CollisionEvent& event : result) {
+        ordered &= previous <= event.restEnergyOut;
+        previous = event.restEnergyOut;
+    }
+    if (ordered) return entry;
+    entry.byKey.reserve(result.size());
+    for (const CollisionEvent& event : result) entry.byKey.push_back(&event);
+    std::stable_sort(entry.byKey.begin(), entry.byKey.end(), [](const CollisionEvent* a, const CollisionEvent* b) {
+        return a->restEnergyOut < b->restEnergyOut;
+    });
+    return entry;
+}
+
+QueryResult CachedIndex::narrow(const Entry& superset, float minRestEnergy, float maxRestEnergy) {
+    QueryResult result;
+    result.keepAlive(superset.result);
+    if (!superset.byKey.empty()) {
+        auto lo = std::lower_bound(superset.byKey.begin(), superset.byKey.end(), minRestEnergy,
+                                   [](const CollisionEvent* e, float key) { return e->restEnergyOut < key; });
+        auto hi = std::upper_bound(lo, superset.byKey.end(), maxRestEnergy,
+                                   [](float key, const CollisionEvent* e) { return key < e->restEnergyOut; });
+        for (; lo != hi; ++lo) result.add(*lo);
+        return result;
+    }
+
+    // Runs in key order: the first run ending at or above the window to the last starting inside it
+    using Span = QueryResult::Span;
+    const std::vector<Span>& runs = superset.result.runs();
+    auto first = std::partition_point(runs.begin(), runs.end(), [minRestEnergy](const Span& run) {
+        return run.first[run.count - 1].restEnergyOut < minRestEnergy;
+    });
+    auto last = std::partition_point(first, runs.end(), [maxRestEnergy](const Span& run) {
+        return run.first[0].restEnergyOut <= maxRestEnergy;
+    });
+    for (auto run = first; run != last; ++run) {
+        const CollisionEvent* begin = run->first;
+        const CollisionEvent* end = run->first + run->count;
+        auto below = [](const CollisionEvent& e, float key) { return e.restEnergyOut < key; };
+        auto above = [](float key, const CollisionEvent& e) { return key < e.restEnergyOut; };
+        if (run == first) begin = std::lower_bound(begin, end, minRestEnergy, below);
+        if (run + 1 == last) end = std::upper_bound(begin, end, maxRestEnergy, above);
+        result.add(begin, end - begin);
+    }
+    return result;
+}
+
+void CachedIndex::remember(Entry entry, size_t missGeneration) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    // The index changed since the miss, so the result may be stale
+    if (missGeneration != generation) return;
+    // A concurrent miss on the same window may have cached it first
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (it->window.minRestEnergy == entry.window.minRestEnergy &&
+            it->window.maxRestEnergy == entry.window.maxRestEnergy) {
+            entries.splice(entries.begin(), entries, it);
+            return;
+        }
+    }
+    entries.push_front(std::move(entry));
+    if (entries.size() > capacity) entries.pop_back();
+}
+
+const CollisionEvent& CachedIndex::find_max_efficiency() const {
+    return index.find_max_efficiency();
+}
+
+QueryResult CachedIndex::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    return index.top_k_in_range(k, minRestEnergy, maxRestEnergy);
+}
+
+Aggregate CachedIndex::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    return index.aggregate(minRestEnergy, maxRestEnergy);
+}
+
+MemoryUsage CachedIndex::memory_usage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryUsage usage;
+    usage.nodes = sizeof(*this);
+    usage.heaps = heapBytes(entries);
+    for (const Entry& entry : entries) usage.heaps += heapBytes(entry.result.runs()) + heapBytes(entry.byKey);
+    return usage;
+}
+
+std::vector<RangeQuery> CachedIndex::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    return index.partition(minRestEnergy, maxRestEnergy, parts);
+}
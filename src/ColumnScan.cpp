@@ -0,0 +1,84 @@
+#include "ColumnScan.h"
+#include "ScanKernels.h"
+#include "TopK.h"
+#include <stdexcept>
+
+void ColumnScan::build(std::vector<CollisionEvent>& events) {
+    this->events = events;
+    keys.resize(events.size());
+    positions.clear();
+    for (size_t i = 0; i < events.size(); ++i) {
+        keys[i] = events[i].restEnergyOut;
+        positions[events[i].eventId] = i;
+    }
+}
+
+void ColumnScan::insert(const CollisionEvent& event) {
+    positions[event.eventId] = events.size();
+    events.push_back(event);
+    keys.push_back(event.restEnergyOut);
+}
+
+bool ColumnScan::erase(int eventId) {
+    auto it = positions.find(eventId);
+    if (it == positions.end()) return false;
+    size_t slot = it->second;
+    positions.erase(it);
+    if (slot + 1 != events.size()) {
+        events[slot] = std::move(events.back());
+        keys[slot] = keys.back();
+        positions[events[slot].eventId] = slot;
+    }
+    events.pop_back();
+    keys.pop_back();
+    return true;
+}
+
+bool ColumnScan::update(const CollisionEvent& event) {
+    auto it = positions.find(event.eventId);
+    if (it == positions.end()) return false;
+    events[it->second] = event;
+    keys[it->second] = event.restEnergyOut;
+    return true;
+}
+
+const CollisionEvent* ColumnScan::find(int eventId) const {
+    auto it = positions.find(eventId);
+    return it == positions.end() ? nullptr : &events[it->second];
+}
+
+QueryResult ColumnScan::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    forEachInRange(keys.data(), keys.size(), minRestEnergy, maxRestEnergy, [&](size_t i) { result.add(&events[i]); });
+    return result;
+}
+
+const CollisionEvent& ColumnScan::find_max_efficiency() const {
+    if (events.empty()) throw std::runtime_error("Empty column");
+    size_t best = 0;
+    for (size_t i = 1; i < events.size(); ++i) {
+        if (events[i].efficiency > events[best].efficiency) best = i;
+    }
+    return events[best];
+}
+
+QueryResult ColumnScan::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    TopK top(k);
+    forEachInRange(keys.data(), keys.size(), minRestEnergy, maxRestEnergy, [&](size_t i) { top.offer(&events[i]); });
+    return top.result();
+}
+
+Aggregate ColumnScan::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    forEachInRange(keys.data(), keys.size(), minRestEnergy, maxRestEnergy, [&](size_t i) { result.add(events[i]); });
+    return result;
+}
+
+MemoryUsage ColumnScan::memory_usage() const {
+    MemoryUsage usage;
+    usage.nodes = sizeof(*this);
+    usage.payload = heapBytes(events) + heapBytes(keys);
+    usage.strings = stringBytes(events);
+    usage.heaps = heapBytes(positions);
+    return usage;
+}
@@ -0,0 +1,71 @@
+#include "CompositionIndex.h"
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+CompositionCut parseCompositionCut(const std::string& text) {
+    CompositionCut cut;
+    std::stringstream terms(text);
+    std::string term;
+    while (std::getline(terms, term, ',')) {
+        term.erase(0, term.find_first_not_of(' '));
+        term.erase(term.find_last_not_of(' ') + 1);
+        if (term.empty()) continue;
+        size_t op = term.find_first_of("<>=");
+        if (op == std::string::npos || op == 0) throw std::runtime_error("Malformed cut term: " + term);
+        std::string name = term.substr(0, op);
+        name.erase(name.find_last_not_of(' ') + 1);
+
+        int type = 0;
+        while (type < NumParticleTypes && name != particleName(static_cast<ParticleType>(type))) ++type;
+        if (type == NumParticleTypes) throw std::runtime_error("Unknown particle in cut: " + name);
+
+        bool atLeast = term[op] == '>', atMost = term[op] == '<';
+        size_t value = op + 1;
+        if (atLeast || atMost) {
+            if (term[value] != '=') throw std::runtime_error("Malformed cut term: " + term);
+            ++value;
+        }
+        char* end = nullptr;
+        long count = std::strtol(term.c_str() + value, &end, 10);
+        if (end == term.c_str() + value || *end != '\0' || count < 0)
+            throw std::runtime_error("Malformed cut term: " + term);
+
+        auto t = static_cast<ParticleType>(type);
+        if (!atMost) cut.atLeast(t, static_cast<int>(count));
+        if (!atLeast) cut.atMost(t, static_cast<int>(count));
+    }
+    return cut;
+}
+
+void CompositionIndex::build(const std::vector<CollisionEvent>& events) {
+    all = Bitmap();
+    for (auto& species : levels) species.clear();
+    for (const auto& event : events) insert(event);
+}
+
+void CompositionIndex::insert(const CollisionEvent& event) {
+    if (event.eventId < 0) throw std::runtime_error("CompositionIndex needs non-negative event ids");
+    auto id = static_cast<uint32_t>(event.eventId);
+    all.add(id);
+    ParticleCounts counts = countParticles(event.outgoingParticles);
+    for (int t = 0; t < NumParticleTypes; ++t) {
+        auto& species = levels[t];
+        if (species.size() < static_cast<size_t>(counts.counts[t])) species.resize(counts.counts[t]);
+        for (int n = 0; n < counts.counts[t]; ++n) species[n].add(id);
+    }
+}
+
+Bitmap CompositionIndex::select(const CompositionCut& cut) const {
+    Bitmap result = all;
+    for (int t = 0; t < NumParticleTypes; ++t) {
+        const auto& species = levels[t];
+        int lo = cut.minCount[t], hi = cut.maxCount[t];
+        if (hi >= 0 && lo > hi) return Bitmap();
+        if (lo > static_cast<int>(species.size())) return Bitmap();  // no event has that many
+        if (lo > 0) result = result & species[lo - 1];
+        // "at most hi" removes everyone with at least hi + 1
+        if (hi >= 0 && hi < static_cast<int>(species.size())) result = result.andNot(species[hi]);
+    }
+    return result;
+}
@@ -1,5 +1,6 @@
 // src/DataLoader.cpp
-#include "CollisionEvent.h"
+#include "DataLoader.h"
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <stdexcept>
@@ -12,7 +13,19 @@
  * Reads data parsed from ROOT files into memory-efficient structures
  */
 std::vector<CollisionEvent> loadData(const std::string& filename) {
+    EnergyRange range;
+    return loadData(filename, range);
+}
+
+/**
+ * @brief Loads collision events and collects their restEnergyOut range in the same pass.
+ * @param filename Path to the binary file.
+ * @param range Receives the min/max restEnergyOut ({0, 0} for an empty file).
+ * @return Vector of CollisionEvent objects.
+ */
+std::vector<CollisionEvent> loadData(const std::string& filename, EnergyRange& range) {
     std::vector<CollisionEvent> events;
+    range = {0, 0};
     std::ifstream file(filename, std::ios::binary);
     if (!file) throw std::runtime_error("File not found");
 
@@ -28,6 +41,9 @@ std::vector<CollisionEvent> loadData(const std::string& filename) {
         if (file) {
             e.incomingParticles = std::string(inParts, 32);
             e.outgoingParticles = std::string(outParts, 256);
+            if (events.empty()) range = {e.restEnergyOut, e.restEnergyOut};
+            range.minRestEnergy = std::min(range.minRestEnergy, e.restEnergyOut);
+            range.maxRestEnergy = std::max(range.maxRestEnergy, e.restEnergyOut);
             events.push_back(e);
         }
     }
@@ -0,0 +1,33 @@
+#include "DataStructure.h"
+
+std::vector<RangeQuery> DataStructure::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    Aggregate window = aggregate(minRestEnergy, maxRestEnergy);
+    std::vector<float> cuts;
+    // Bisect between the window's actual keys, which are finite even when its bounds are not
+    float lo = window.minRestEnergy;
+    for (size_t p = 1; p < parts && window.count > 1; ++p) {
+        size_t target = window.count * p / parts;
+        float hi = window.maxRestEnergy;
+        for (int step = 0; step < 24 && lo < hi; ++step) {
+            float mid = lo + (hi - lo) / 2;
+            if (aggregate(minRestEnergy, mid).count < target) lo = mid;
+            else hi = mid;
+        }
+        cuts.push_back(hi);
+        lo = hi;
+    }
+    return windowsFromCuts(minRestEnergy, maxRestEnergy, cuts);
+}
+
+std::vector<RangeQuery> DataStructure::windowsFromCuts(float minRestEnergy, float maxRestEnergy,
+                                                       const std::vector<float>& cuts) {
+    std::vector<RangeQuery> windows;
+    float start = minRestEnergy;
+    for (float cut : cuts) {
+        if (!(cut > start) || cut > maxRestEnergy) continue;
+        windows.push_back({start, std::nextafter(cut, -std::numeric_limits<float>::infinity())});
+        start = cut;
+    }
+    windows.push_back({start, maxRestEnergy});
+    return windows;
+}
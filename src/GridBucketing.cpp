@@ -1,55 +1,748 @@
 #include <GridBucketing.h>
+#include "ParticleCounts.h"
+#include "ScanKernels.h"
+#include "TopK.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+const size_t noCell = static_cast<size_t>(-1);
+const size_t minSplitSize = 64;  ///< cells smaller than this are never split
+
+/// Aggregate and maximum of the live events; cheap enough to redo on every erase.
+void resetAggregate(Cell& cell) {
+    cell.maxIndex = 0;
+    cell.summary = Aggregate();
+    for (size_t k = 0; k < cell.events.size(); ++k) {
+        if (std::isnan(cell.keys[k])) continue;
+        if (!cell.summary.count || cell.events[k].efficiency > cell.events[cell.maxIndex].efficiency)
+            cell.maxIndex = k;
+        cell.summary.add(cell.events[k]);
+    }
+}
+
+void resetSummary(Cell& cell) {
+    resetAggregate(cell);
+    cell.efficiencySketch = QuantileSketch();
+    cell.restEnergySketch = QuantileSketch();
+    for (size_t k = 0; k < cell.events.size(); ++k) {
+        if (std::isnan(cell.keys[k])) continue;
+        cell.efficiencySketch.add(cell.events[k].efficiency);
+        cell.restEnergySketch.add(cell.keys[k]);
+    }
+}
+
+/// Grid geometry at the head of a snapshot; boundaries and then the cells follow.
+struct GridRecord {
+    float minRest, maxRest, bucketRange, rowRange, minAxis, maxAxis;
+    uint32_t axis, adaptive;
+    uint64_t numRows, gridSize, maxGridSize, boundaryCount;
+};
+
+void compact(Cell& cell) {
+    size_t kept = 0;
+    bool hasAxis = !cell.axisKeys.empty();
+    for (size_t k = 0; k < cell.events.size(); ++k) {
+        if (std::isnan(cell.keys[k])) continue;
+        if (kept != k) {
+            cell.events[kept] = std::move(cell.events[k]);
+            cell.keys[kept] = cell.keys[k];
+            if (hasAxis) cell.axisKeys[kept] = cell.axisKeys[k];
+        }
+        ++kept;
+    }
+    cell.events.resize(kept);
+    cell.keys.resize(kept);
+    if (hasAxis) cell.axisKeys.resize(kept);
+    cell.tombstones = 0;
+    resetSummary(cell);
+}
+}
 
 GridBucketing::GridBucketing(float minRestEnergy, float maxRestEnergy, size_t size) :
-    numRows(1), gridSize(size), minKinetic(13000), maxKinetic(13000), minRest(minRestEnergy), maxRest(maxRestEnergy) {
-    bucketRange = (maxRest - minRest + 1e-6) / gridSize;
-    for (size_t i = 0; i < numRows; ++i) {
-        grid.push_back(std::vector<Cell>(size, {std::vector<CollisionEvent>(),
-                                        std::priority_queue<CollisionEvent, std::vector<CollisionEvent>,
-                                            std::function<bool(CollisionEvent, CollisionEvent)>>(
-                                                [](const CollisionEvent& a, const CollisionEvent& b) {
-                                                return a.efficiency < b.efficiency;
-                                                })}));
+    GridBucketing(minRestEnergy, maxRestEnergy, size, GridAxis::None, 0, 0, 1) {}
+
+GridBucketing::GridBucketing(float minRestEnergy, float maxRestEnergy, size_t size,
+                             GridAxis axis, float minAxisValue, float maxAxisValue, size_t rows) :
+    numRows(axis == GridAxis::None ? 1 : rows), gridSize(size), axis(axis), minAxis(minAxisValue),
+    maxAxis(maxAxisValue), minRest(minRestEnergy), maxRest(maxRestEnergy), maxGridSize(4 * size) {
+    bucketRange = cellWidth();
+    // Exact row width so integer-valued axes (particle counts) land one value per row
+    rowRange = maxAxis > minAxis ? (maxAxis - minAxis) / numRows : 1.0f;
+    resetCells();
+}
+
+float GridBucketing::axisValue(const CollisionEvent& event) const {
+    switch (axis) {
+        case GridAxis::Multiplicity: return countParticles(event.outgoingParticles).total();
+        case GridAxis::JetCount: return countParticles(event.outgoingParticles)[Jet];
+        default: return minAxis;
+    }
+}
+
+unsigned int GridBucketing::getRow(float axisValue) const {
+    if (numRows == 1) return 0;
+    float x = (axisValue - minAxis) / rowRange;
+    if (!(x > 0)) return 0;
+    return static_cast<unsigned int>(std::min(x, static_cast<float>(numRows - 1)));
+}
+
+unsigned int GridBucketing::getColumn(float restEnergy) const {
+    if (adaptive) {
+        // Interior edges only: the outer cells absorb anything beyond the range
+        auto it = std::upper_bound(boundaries.begin() + 1, boundaries.end() - 1, restEnergy);
+        return it - (boundaries.begin() + 1);
+    }
+    // Clamp before converting: unbounded query edges (e.g. top_k's infinities) overflow an int
+    double y = (static_cast<double>(restEnergy) - minRest) / bucketRange;
+    if (!(y > 0)) return 0;
+    return static_cast<unsigned int>(std::min(y, static_cast<double>(gridSize - 1)));
+}
+
+float GridBucketing::cellWidth() const {
+    // In double: the span between the largest floats overflows a float
+    return static_cast<float>((static_cast<double>(maxRest) - minRest + 1e-6) / gridSize);
+}
+
+std::pair<unsigned int, unsigned int> GridBucketing::getCellIndices(float restEnergy, float axisValue) const {
+    return {getRow(axisValue), getColumn(restEnergy)};
+}
+
+const Cell* GridBucketing::cellAt(size_t flatIndex) const {
+    return &grid[flatIndex / gridSize][flatIndex % gridSize];
+}
+
+size_t GridBucketing::winner(size_t a, size_t b) const {
+    if (a == noCell || b == noCell) return (a == noCell) ? b : a;
+    const Cell* ca = cellAt(a);
+    const Cell* cb = cellAt(b);
+    return (cb->events[cb->maxIndex].efficiency > ca->events[ca->maxIndex].efficiency) ? b : a;
+}
+
+void GridBucketing::updateTournament(size_t flatIndex) {
+    size_t node = leafCount + flatIndex;
+    tournament[node] = cellAt(flatIndex)->live() == 0 ? noCell : flatIndex;
+    for (node /= 2; node >= 1; node /= 2)
+        tournament[node] = winner(tournament[2 * node], tournament[2 * node + 1]);
+}
+
+void GridBucketing::rebuildTournament() {
+    leafCount = 1;
+    while (leafCount < numRows * gridSize) leafCount *= 2;
+    tournament.assign(2 * leafCount, noCell);
+    for (size_t i = 0; i < numRows * gridSize; ++i)
+        tournament[leafCount + i] = cellAt(i)->live() == 0 ? noCell : i;
+    for (size_t node = leafCount - 1; node >= 1; --node)
+        tournament[node] = winner(tournament[2 * node], tournament[2 * node + 1]);
+}
+
+void GridBucketing::adaptBoundaries(const std::vector<CollisionEvent>& events, size_t sampleSize) {
+    if (events.empty()) return;
+    // Evenly strided sample keeps the pass cheap and deterministic
+    size_t stride = std::max<size_t>(1, events.size() / std::max<size_t>(1, sampleSize));
+    std::vector<float> sample;
+    for (size_t i = 0; i < events.size(); i += stride) sample.push_back(events[i].restEnergyOut);
+    std::sort(sample.begin(), sample.end());
+
+    // Equi-depth edges; repeated quantiles collapse so no cell is empty by construction
+    std::vector<float> edges = {minRest};
+    for (size_t c = 1; c < gridSize; ++c) {
+        float q = sample[c * sample.size() / gridSize];
+        if (q > edges.back() && q < maxRest) edges.push_back(q);
     }
+    edges.push_back(maxRest);
+
+    auto stored = drain();
+    adaptive = true;
+    boundaries = std::move(edges);
+    gridSize = boundaries.size() - 1;
+    resetCells();
+    for (auto& [event, value] : stored) place(std::move(event), value);
+}
+
+std::vector<std::pair<CollisionEvent, float>> GridBucketing::drain() {
+    std::vector<std::pair<CollisionEvent, float>> stored;
+    stored.reserve(totalEvents);
+    for (auto& row : grid) {
+        for (auto& cell : row) {
+            for (size_t k = 0; k < cell.events.size(); ++k) {
+                if (!std::isnan(cell.keys[k]))
+                    stored.emplace_back(std::move(cell.events[k]), cell.axisKeys.empty() ? minAxis : cell.axisKeys[k]);
+            }
+        }
+    }
+    grid.clear();
+    totalEvents = 0;
+    return stored;
+}
+
+void GridBucketing::resetCells() {
+    // Destroy the old cells before their buffers' memory is released in one step
+    grid.clear();
+    arena.reset();
+    grid.assign(numRows, std::vector<Cell>(gridSize, Cell(&arena)));
+    totalEvents = 0;
+    rebuildTournament();
 }
 
-std::pair<unsigned int, unsigned int> GridBucketing::getCellIndices(float restEnergy) {
-    std::pair<unsigned int, unsigned int> indices = {0, 0};
-    int y = (restEnergy - minRest) / bucketRange;
-    indices.second = std::clamp(y, 0, static_cast<int>(gridSize - 1));
-    return indices;
+void GridBucketing::growRange(float restEnergy) {
+    if (adaptive) {
+        // Equi-depth edges only move outward; hot-cell splits absorb the new density
+        minRest = std::min(minRest, restEnergy);
+        maxRest = std::max(maxRest, restEnergy);
+        boundaries.front() = minRest;
+        boundaries.back() = maxRest;
+        return;
+    }
+    // Doubling the span keeps the number of rebuckets logarithmic in the final range; in double,
+    // and clamped to the largest floats, so huge finite keys never push an edge to infinity
+    const double largest = std::numeric_limits<float>::max();
+    double span = std::max(static_cast<double>(maxRest) - minRest, 1.0);
+    double newMin = minRest, newMax = maxRest;
+    while (restEnergy < newMin) { newMin = std::max(newMin - span, -largest); span *= 2; }
+    while (restEnergy > newMax) { newMax = std::min(newMax + span, largest); span *= 2; }
+
+    auto stored = drain();
+    minRest = static_cast<float>(newMin);
+    maxRest = static_cast<float>(newMax);
+    bucketRange = cellWidth();
+    resetCells();
+    for (auto& [event, value] : stored) place(std::move(event), value);
+}
+
+void GridBucketing::splitColumn(size_t column) {
+    std::vector<float> keys;
+    size_t live = 0;
+    for (auto& row : grid) {
+        if (row[column].tombstones) compact(row[column]);
+        live += row[column].keys.size();
+        // Infinite keys live in the outer columns but can never be an edge
+        for (float k : row[column].keys) {
+            if (std::isfinite(k)) keys.push_back(k);
+        }
+    }
+    // A column mostly of infinite keys stays hot whatever the split, so it is left whole
+    if (keys.empty() || keys.size() * 2 < live) return;
+    auto mid = keys.begin() + keys.size() / 2;
+    std::nth_element(keys.begin(), mid, keys.end());
+    float split = *mid;
+
+    // Keys below the split stay; if the median is the column minimum, split just above it
+    if (std::none_of(keys.begin(), keys.end(), [split](float k) { return k < split; })) {
+        float next = std::numeric_limits<float>::infinity();
+        for (float k : keys)
+            if (k > split) next = std::min(next, k);
+        if (next == std::numeric_limits<float>::infinity()) return;  // all keys equal
+        split = next;
+    }
+    // Edges must stay strictly ascending, or a column would be empty by construction
+    if (!(split > boundaries[column] && split < boundaries[column + 1])) return;
+
+    for (auto& row : grid) {
+        Cell& low = row[column];
+        Cell high(&arena);
+        size_t kept = 0;
+        bool hasAxis = !low.axisKeys.empty();
+        for (size_t k = 0; k < low.events.size(); ++k) {
+            if (low.keys[k] >= split) {
+                high.events.push_back(std::move(low.events[k]));
+                high.keys.push_back(low.keys[k]);
+                if (hasAxis) high.axisKeys.push_back(low.axisKeys[k]);
+            } else {
+                low.events[kept] = std::move(low.events[k]);
+                if (hasAxis) low.axisKeys[kept] = low.axisKeys[k];
+                low.keys[kept++] = low.keys[k];
+            }
+        }
+        low.events.resize(kept);
+        low.keys.resize(kept);
+        if (hasAxis) low.axisKeys.resize(kept);
+        resetSummary(low);
+        resetSummary(high);
+        row.insert(row.begin() + column + 1, std::move(high));
+    }
+    boundaries.insert(boundaries.begin() + column + 1, split);
+    ++gridSize;
+    rebuildTournament();
 }
 
 void GridBucketing::insert(const CollisionEvent& event) {
-    auto [i, j] = getCellIndices(event.restEnergyOut);
+    if ((event.restEnergyOut < minRest || event.restEnergyOut > maxRest) && std::isfinite(event.restEnergyOut))
+        growRange(event.restEnergyOut);
+    place(event, axisValue(event));
+}
+
+bool GridBucketing::erase(int eventId) {
+    if (!locatorBuilt) buildLocator();
+    auto it = locator.find(eventId);
+    if (it == locator.end()) return false;
+    unsigned int column = getColumn(it->second);
+    for (unsigned int r = 0; r < numRows; ++r) {
+        Cell& cell = grid[r][column];
+        for (size_t k = 0; k < cell.events.size(); ++k) {
+            if (std::isnan(cell.keys[k]) || cell.events[k].eventId != eventId) continue;
+            // Tombstone: a NaN key fails every range comparison, so scans skip it for free
+            cell.keys[k] = std::numeric_limits<float>::quiet_NaN();
+            if (!cell.axisKeys.empty()) cell.axisKeys[k] = std::numeric_limits<float>::quiet_NaN();
+            ++cell.tombstones;
+            --totalEvents;
+            locator.erase(it);
+            // The sketches keep the erased value until compaction rebuilds them; windows scan the cell meanwhile
+            if (cell.tombstones * 4 > cell.events.size()) compact(cell);
+            else resetAggregate(cell);
+            updateTournament(r * gridSize + column);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GridBucketing::update(const CollisionEvent& event) {
+    if (!erase(event.eventId)) return false;
+    insert(event);
+    return true;
+}
+
+void GridBucketing::buildLocator() {
+    locator.clear();
+    locator.reserve(totalEvents);
+    for (const auto& row : grid) {
+        for (const auto& cell : row) {
+            for (size_t k = 0; k < cell.events.size(); ++k) {
+                if (!std::isnan(cell.keys[k])) locator[cell.events[k].eventId] = cell.keys[k];
+            }
+        }
+    }
+    locatorBuilt = true;
+}
+
+void GridBucketing::place(CollisionEvent event, float value) {
+    auto [i, j] = getCellIndices(event.restEnergyOut, value);
     Cell& cell = grid[i][j];
-    cell.events.push_back(event);
-    cell.maxHeap.push(event);
+    if (locatorBuilt) locator[event.eventId] = event.restEnergyOut;
+    cell.keys.push_back(event.restEnergyOut);
+    cell.events.push_back(std::move(event));
+    if (axis != GridAxis::None) cell.axisKeys.push_back(value);
+    cell.summary.add(cell.events.back());
+    cell.efficiencySketch.add(cell.events.back().efficiency);
+    cell.restEnergySketch.add(cell.keys.back());
+    ++totalEvents;
+    // Only a new cell maximum can change the tournament
+    if (cell.live() == 1 || cell.events.back().efficiency > cell.events[cell.maxIndex].efficiency) {
+        cell.maxIndex = cell.events.size() - 1;
+        updateTournament(i * gridSize + j);
+    }
+
+    // Hot-cell check at power-of-two sizes keeps the amortized cost O(1) per insert
+    size_t size = cell.events.size();
+    if (adaptive && gridSize < maxGridSize && size >= minSplitSize && (size & (size - 1)) == 0 &&
+        size * numRows * gridSize > hotFactor * totalEvents) {
+        splitColumn(j);
+    }
 }
 
-std::vector<CollisionEvent> GridBucketing::range_query(float minRestEnergy, float maxRestEnergy) {
-    std::vector<CollisionEvent> result;
-    auto minIndices = getCellIndices(minRestEnergy);
-    auto maxIndices = getCellIndices(maxRestEnergy);
-    for (unsigned int i = minIndices.second; i <= maxIndices.second; ++i) {
-        Cell& cell = grid[minIndices.first][i];
-        for (const CollisionEvent& event : cell.events) {
-            if (minRestEnergy <= event.restEnergyOut && event.restEnergyOut <= maxRestEnergy)
-                result.push_back(event);
+void GridBucketing::insertBulk(const std::vector<CollisionEvent>& events, unsigned int threads) {
+    if (events.empty()) return;
+    // Grow once up front so no worker ever sees a rebucket
+    auto [lo, hi] = std::minmax_element(events.begin(), events.end(),
+                                        [](const CollisionEvent& a, const CollisionEvent& b) {
+                                            return a.restEnergyOut < b.restEnergyOut;
+                                        });
+    if (lo->restEnergyOut < minRest && std::isfinite(lo->restEnergyOut)) growRange(lo->restEnergyOut);
+    if (hi->restEnergyOut > maxRest && std::isfinite(hi->restEnergyOut)) growRange(hi->restEnergyOut);
+
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned int>(std::min<size_t>(threads, events.size()));
+    if (threads == 1) {
+        for (const auto& event : events) place(event, axisValue(event));
+        return;
+    }
+    const size_t cells = numRows * gridSize;
+    std::vector<float> values(events.size());
+    std::vector<std::vector<std::vector<size_t>>> local(threads, std::vector<std::vector<size_t>>(cells));
+
+    // Phase 1: each worker buckets its slice into thread-local per-cell lists
+    auto bucket = [&](unsigned int t) {
+        size_t begin = events.size() * t / threads, end = events.size() * (t + 1) / threads;
+        for (size_t k = begin; k < end; ++k) {
+            values[k] = axisValue(events[k]);
+            auto [i, j] = getCellIndices(events[k].restEnergyOut, values[k]);
+            local[t][i * gridSize + j].push_back(k);
+        }
+    };
+    // Phase 2: each worker owns a block of cells and appends every slice's events in input order
+    auto merge = [&](unsigned int t) {
+        for (size_t c = cells * t / threads; c < cells * (t + 1) / threads; ++c) {
+            Cell& cell = grid[c / gridSize][c % gridSize];
+            for (const auto& slice : local) {
+                for (size_t k : slice[c]) {
+                    cell.events.push_back(events[k]);
+                    cell.keys.push_back(events[k].restEnergyOut);
+                    if (axis != GridAxis::None) cell.axisKeys.push_back(values[k]);
+                    cell.summary.add(events[k]);
+                    cell.efficiencySketch.add(events[k].efficiency);
+                    cell.restEnergySketch.add(events[k].restEnergyOut);
+                    if (cell.live() == 1 || events[k].efficiency > cell.events[cell.maxIndex].efficiency)
+                        cell.maxIndex = cell.events.size() - 1;
+                }
+            }
+        }
+    };
+    auto runWorkers = [threads](const auto& work) {
+        std::vector<std::thread> workers;
+        for (unsigned int t = 1; t < threads; ++t) workers.emplace_back(work, t);
+        work(0);
+        for (auto& worker : workers) worker.join();
+    };
+    runWorkers(bucket);
+    // The arena is not thread-safe, so every cell is sized here and the workers never touch the arena
+    for (size_t c = 0; c < cells; ++c) {
+        Cell& cell = grid[c / gridSize][c % gridSize];
+        size_t added = 0;
+        for (const auto& slice : local) added += slice[c].size();
+        if (added == 0) continue;
+        cell.events.reserve(cell.events.size() + added);
+        cell.keys.reserve(cell.keys.size() + added);
+        if (axis != GridAxis::None) cell.axisKeys.reserve(cell.axisKeys.size() + added);
+    }
+    runWorkers(merge);
+
+    totalEvents += events.size();
+    if (locatorBuilt) {
+        for (const auto& event : events) locator[event.eventId] = event.restEnergyOut;
+    }
+    rebuildTournament();
+    if (adaptive) splitHotColumns();
+}
+
+void GridBucketing::splitHotColumns() {
+    while (gridSize < maxGridSize) {
+        size_t largest = 0, column = 0;
+        for (const auto& row : grid) {
+            for (size_t j = 0; j < gridSize; ++j) {
+                if (row[j].live() > largest) {
+                    largest = row[j].live();
+                    column = j;
+                }
+            }
+        }
+        if (largest < minSplitSize || largest * numRows * gridSize <= hotFactor * totalEvents) return;
+        size_t before = gridSize;
+        splitColumn(column);
+        if (gridSize == before) return;  // identical keys, nothing to split
+    }
+}
+
+void GridBucketing::scanCell(const Cell& cell, bool interior, float minRestEnergy, float maxRestEnergy,
+                             QueryResult& result) const {
+    // getColumn is monotonic, so every key in a column strictly between the end columns is in range
+    if (interior && cell.tombstones == 0) {
+        result.add(cell.events.data(), cell.events.size());
+        return;
+    }
+    forEachInRange(cell.keys.data(), cell.keys.size(), minRestEnergy, maxRestEnergy,
+                   [&](size_t k) { result.add(&cell.events[k]); });
+}
+
+QueryResult GridBucketing::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    unsigned int minColumn = getColumn(minRestEnergy);
+    unsigned int maxColumn = getColumn(maxRestEnergy);
+    for (const auto& row : grid) {
+        for (unsigned int i = minColumn; i <= maxColumn; ++i)
+            scanCell(row[i], i > minColumn && i < maxColumn, minRestEnergy, maxRestEnergy, result);
+    }
+    return result;
+}
+
+std::vector<QueryResult> GridBucketing::range_query_batch(const std::vector<RangeQuery>& queries) const {
+    struct Window {
+        size_t query;
+        unsigned int minColumn, maxColumn;
+    };
+    std::vector<QueryResult> results(queries.size());
+    std::vector<Window> windows;
+    for (size_t q = 0; q < queries.size(); ++q) {
+        if (queries[q].minRestEnergy <= queries[q].maxRestEnergy)
+            windows.push_back({q, getColumn(queries[q].minRestEnergy), getColumn(queries[q].maxRestEnergy)});
+    }
+    std::sort(windows.begin(), windows.end(),
+              [](const Window& a, const Window& b) { return a.minColumn < b.minColumn; });
+
+    std::vector<Window> active;
+    for (const auto& row : grid) {
+        size_t next = 0;
+        active.clear();
+        for (unsigned int i = 0; i < gridSize && (next < windows.size() || !active.empty()); ++i) {
+            if (active.empty() && windows[next].minColumn > i) i = windows[next].minColumn;
+            while (next < windows.size() && windows[next].minColumn == i) active.push_back(windows[next++]);
+            for (const Window& w : active) {
+                const RangeQuery& q = queries[w.query];
+                scanCell(row[i], i > w.minColumn && i < w.maxColumn, q.minRestEnergy, q.maxRestEnergy,
+                         results[w.query]);
+            }
+            active.erase(std::remove_if(active.begin(), active.end(),
+                                        [i](const Window& w) { return w.maxColumn == i; }),
+                         active.end());
+        }
+    }
+    return results;
+}
+
+QueryResult GridBucketing::range_query_2d(float minRestEnergy, float maxRestEnergy,
+                                          float minAxisValue, float maxAxisValue) const {
+    if (axis == GridAxis::None) return range_query_view(minRestEnergy, maxRestEnergy);
+    QueryResult result;
+    if (!(minRestEnergy <= maxRestEnergy) || !(minAxisValue <= maxAxisValue)) return result;
+    auto [minRow, minColumn] = getCellIndices(minRestEnergy, minAxisValue);
+    auto [maxRow, maxColumn] = getCellIndices(maxRestEnergy, maxAxisValue);
+    for (unsigned int r = minRow; r <= maxRow; ++r) {
+        for (unsigned int i = minColumn; i <= maxColumn; ++i) {
+            const Cell& cell = grid[r][i];
+            if (r > minRow && r < maxRow) {
+                scanCell(cell, i > minColumn && i < maxColumn, minRestEnergy, maxRestEnergy, result);
+                continue;
+            }
+            forEachInRange(cell.keys.data(), cell.keys.size(), minRestEnergy, maxRestEnergy, [&](size_t k) {
+                if (minAxisValue <= cell.axisKeys[k] && cell.axisKeys[k] <= maxAxisValue) result.add(&cell.events[k]);
+            });
+        }
+    }
+    return result;
+}
+
+const CollisionEvent& GridBucketing::find_max_efficiency() const {
+    size_t best = tournament[1];
+    if (best == noCell) throw std::runtime_error("Empty grid");
+    const Cell* cell = cellAt(best);
+    return cell->events[cell->maxIndex];
+}
+
+const CollisionEvent& GridBucketing::find_max_efficiency_in_row(float axisValue) const {
+    const Cell* best = nullptr;
+    for (const Cell& cell : grid[getRow(axisValue)]) {
+        if (cell.live() &&
+            (!best || cell.events[cell.maxIndex].efficiency > best->events[best->maxIndex].efficiency))
+            best = &cell;
+    }
+    if (!best) throw std::runtime_error("Empty row");
+    return best->events[best->maxIndex];
+}
+
+const CollisionEvent& GridBucketing::find_max_efficiency_in_column(float restEnergy) const {
+    unsigned int column = getColumn(restEnergy);
+    const Cell* best = nullptr;
+    for (const auto& row : grid) {
+        const Cell& cell = row[column];
+        if (cell.live() &&
+            (!best || cell.events[cell.maxIndex].efficiency > best->events[best->maxIndex].efficiency))
+            best = &cell;
+    }
+    if (!best) throw std::runtime_error("Empty column");
+    return best->events[best->maxIndex];
+}
+
+QueryResult GridBucketing::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    TopK top(k);
+    if (!(minRestEnergy <= maxRestEnergy)) return top.result();
+    unsigned int minColumn = getColumn(minRestEnergy);
+    unsigned int maxColumn = getColumn(maxRestEnergy);
+
+    // Visit cells by their max efficiency; stop once no cell maximum can enter the heap
+    std::vector<const Cell*> cells;
+    for (const auto& row : grid) {
+        for (unsigned int i = minColumn; i <= maxColumn; ++i) {
+            if (row[i].live()) cells.push_back(&row[i]);
+        }
+    }
+    auto lessPromising = [](const Cell* a, const Cell* b) {
+        return a->events[a->maxIndex].efficiency < b->events[b->maxIndex].efficiency;
+    };
+    std::make_heap(cells.begin(), cells.end(), lessPromising);
+    while (!cells.empty() && top.admits(cells.front()->events[cells.front()->maxIndex].efficiency)) {
+        std::pop_heap(cells.begin(), cells.end(), lessPromising);
+        const Cell& cell = *cells.back();
+        cells.pop_back();
+        forEachInRange(cell.keys.data(), cell.keys.size(), minRestEnergy, maxRestEnergy,
+                       [&](size_t i) { top.offer(&cell.events[i]); });
+    }
+    return top.result();
+}
+
+Aggregate GridBucketing::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    unsigned int minColumn = getColumn(minRestEnergy);
+    unsigned int maxColumn = getColumn(maxRestEnergy);
+    for (const auto& row : grid) {
+        for (unsigned int i = minColumn; i <= maxColumn; ++i) {
+            const Cell& cell = row[i];
+            if (cell.summary.disjoint(minRestEnergy, maxRestEnergy)) continue;
+            // Interior cells, and edge cells whose keys all fall inside, merge without a scan
+            if ((i > minColumn && i < maxColumn) || cell.summary.within(minRestEnergy, maxRestEnergy)) {
+                result.merge(cell.summary);
+                continue;
+            }
+            forEachInRange(cell.keys.data(), cell.keys.size(), minRestEnergy, maxRestEnergy,
+                           [&](size_t k) { result.add(cell.events[k]); });
         }
     }
     return result;
 }
 
-CollisionEvent GridBucketing::find_max_efficiency() {
-    CollisionEvent maxEff = grid[0][0].maxHeap.top();
-    for (unsigned int i = 0; i < numRows; ++i) {
-        for (unsigned int i = 1; i < gridSize; ++i) {
-            Cell& cell = grid[0][i];
-            if (!cell.maxHeap.empty() && cell.maxHeap.top().efficiency > maxEff.efficiency)
-                maxEff = cell.maxHeap.top();
+void GridBucketing::save_snapshot(const std::string& path, const SnapshotSource& source) const {
+    SnapshotWriter writer(SnapshotKind::GridBucketing, source);
+    writer.add_record(GridRecord{minRest, maxRest, bucketRange, rowRange, minAxis, maxAxis,
+                                 static_cast<uint32_t>(axis), adaptive, numRows, gridSize, maxGridSize,
+                                 boundaries.size()});
+    for (float edge : boundaries) writer.add_record(edge);
+    // Per cell: live count, then its row-axis keys; the events go to the table in the same order
+    for (const auto& row : grid) {
+        for (const auto& cell : row) {
+            writer.add_record<uint64_t>(cell.live());
+            for (size_t k = 0; k < cell.events.size(); ++k) {
+                if (std::isnan(cell.keys[k])) continue;
+                writer.add_event(cell.events[k]);
+                if (axis != GridAxis::None) writer.add_record(cell.axisKeys[k]);
+            }
         }
     }
-    return maxEff;
+    writer.write(path);
+}
+
+void GridBucketing::load_snapshot(const SnapshotImage& image) {
+    if (image.kind() != SnapshotKind::GridBucketing) throw std::runtime_error("Not a GridBucketing snapshot");
+    size_t offset = 0, nextEvent = 0;
+    // The layout is validated before any member changes, so a rejected snapshot leaves the grid as it was
+    GridRecord record = image.read<GridRecord>(offset);
+    bool widths = record.bucketRange > 0 && std::isfinite(record.bucketRange) &&
+                  record.rowRange > 0 && std::isfinite(record.rowRange);
+    const size_t maxCells = std::numeric_limits<size_t>::max() / sizeof(uint64_t);
+    if (record.numRows == 0 || record.gridSize == 0 || record.gridSize > maxCells / record.numRows || !widths ||
+        !(record.minRest <= record.maxRest) || record.axis > static_cast<uint32_t>(GridAxis::JetCount) ||
+        (record.axis == static_cast<uint32_t>(GridAxis::None) && record.numRows != 1))
+        throw std::runtime_error("Malformed snapshot");
+    std::vector<float> edges;
+    for (uint64_t i = 0; i < record.boundaryCount; ++i) edges.push_back(image.read<float>(offset));
+    if (record.adaptive && (edges.size() != record.gridSize + 1 || !std::is_sorted(edges.begin(), edges.end())))
+        throw std::runtime_error("Malformed snapshot");
+    // Every cell records at least its event count, which bounds the grid by the image size
+    image.view<char>(offset, record.numRows * record.gridSize * sizeof(uint64_t));
+
+    minRest = record.minRest;
+    maxRest = record.maxRest;
+    bucketRange = record.bucketRange;
+    rowRange = record.rowRange;
+    minAxis = record.minAxis;
+    maxAxis = record.maxAxis;
+    axis = static_cast<GridAxis>(record.axis);
+    adaptive = record.adaptive != 0;
+    numRows = record.numRows;
+    gridSize = record.gridSize;
+    maxGridSize = record.maxGridSize;
+    boundaries = std::move(edges);
+    locator.clear();
+    locatorBuilt = false;
+
+    resetCells();
+    try {
+        for (auto& row : grid) {
+            for (auto& cell : row) {
+                uint64_t live = image.read<uint64_t>(offset);
+                if (live > image.event_count() - nextEvent) throw std::runtime_error("Malformed snapshot");
+                cell.events.reserve(live);
+                cell.keys.reserve(live);
+                if (axis != GridAxis::None) cell.axisKeys.reserve(live);
+                for (uint64_t k = 0; k < live; ++k) {
+                    cell.events.push_back(image.event(nextEvent++));
+                    cell.keys.push_back(cell.events.back().restEnergyOut);
+                    if (axis != GridAxis::None) cell.axisKeys.push_back(image.read<float>(offset));
+                }
+                resetSummary(cell);
+            }
+        }
+        if (nextEvent != image.event_count()) throw std::runtime_error("Malformed snapshot");
+    } catch (const std::runtime_error&) {
+        // Past the layout checks the shape is consistent; drop the partly restored cells
+        resetCells();
+        throw;
+    }
+    totalEvents = nextEvent;
+    rebuildTournament();
+}
+
+MemoryUsage GridBucketing::memory_usage() const {
+    MemoryUsage usage;
+    usage.nodes = sizeof(*this) + heapBytes(grid) + heapBytes(tournament) + heapBytes(boundaries);
+    for (const auto& row : grid) {
+        usage.nodes += heapBytes(row);
+        for (const Cell& cell : row) {
+            usage.payload += heapBytes(cell.events) + heapBytes(cell.keys) + heapBytes(cell.axisKeys);
+            usage.strings += stringBytes(cell.events);
+            usage.heaps += cell.efficiencySketch.heap_bytes() + cell.restEnergySketch.heap_bytes();
+        }
+    }
+    // The rest of the arena is spare block space and buffers freed by growth, compaction and splits
+    usage.nodes += arena.reserved() - usage.payload;
+    usage.heaps += heapBytes(locator);
+    return usage;
+}
+
+QuantileSketch GridBucketing::efficiency_quantiles(float minRestEnergy, float maxRestEnergy) const {
+    return sketchWindow(&Cell::efficiencySketch, &CollisionEvent::efficiency, minRestEnergy, maxRestEnergy);
+}
+
+QuantileSketch GridBucketing::rest_energy_quantiles(float minRestEnergy, float maxRestEnergy) const {
+    return sketchWindow(&Cell::restEnergySketch, &CollisionEvent::restEnergyOut, minRestEnergy, maxRestEnergy);
+}
+
+QuantileSketch GridBucketing::sketchWindow(QuantileSketch Cell::*sketch, float CollisionEvent::*field,
+                                           float minRestEnergy, float maxRestEnergy) const {
+    QuantileSketch result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    unsigned int minColumn = getColumn(minRestEnergy);
+    unsigned int maxColumn = getColumn(maxRestEnergy);
+    // Same cell classification as aggregate(): covered cells merge, cut cells are scanned.
+    // A cell with tombstones is scanned too, since its sketch still holds the erased values.
+    for (const auto& row : grid) {
+        for (unsigned int i = minColumn; i <= maxColumn; ++i) {
+            const Cell& cell = row[i];
+            if (cell.summary.disjoint(minRestEnergy, maxRestEnergy)) continue;
+            bool covered = (i > minColumn && i < maxColumn) || cell.summary.within(minRestEnergy, maxRestEnergy);
+            if (covered && cell.tombstones == 0) {
+                result.merge(cell.*sketch);
+                continue;
+            }
+            forEachInRange(cell.keys.data(), cell.keys.size(), minRestEnergy, maxRestEnergy,
+                           [&](size_t k) { result.add(cell.events[k].*field); });
+        }
+    }
+    return result;
+}
+
+std::vector<RangeQuery> GridBucketing::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    if (!(minRestEnergy <= maxRestEnergy)) return {{minRestEnergy, maxRestEnergy}};
+    unsigned int minColumn = getColumn(minRestEnergy);
+    unsigned int maxColumn = getColumn(maxRestEnergy);
+    std::vector<size_t> columnCounts(maxColumn - minColumn + 1);
+    size_t total = 0;
+    for (const auto& row : grid) {
+        for (unsigned int i = minColumn; i <= maxColumn; ++i) columnCounts[i - minColumn] += row[i].live();
+    }
+    for (size_t count : columnCounts) total += count;
+
+    // Cut at the lower edge of the column where the running count passes each share
+    std::vector<float> cuts;
+    size_t seen = 0, part = 1;
+    for (unsigned int i = minColumn; i < maxColumn && part < parts; ++i) {
+        seen += columnCounts[i - minColumn];
+        if (seen * parts < part * total) continue;
+        cuts.push_back(adaptive ? boundaries[i + 1] : minRest + (i + 1) * bucketRange);
+        while (part < parts && seen * parts >= part * total) ++part;
+    }
+    return windowsFromCuts(minRestEnergy, maxRestEnergy, cuts);
 }
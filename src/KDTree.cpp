@@ -1,86 +1,436 @@
 #include "KDTree.h"
+#include "ScanKernels.h"
+#include "TopK.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
 #include <stdexcept>
 
+namespace {
+/// One node of a snapshot, in preorder; a leaf's events follow in the event table.
+struct NodeRecord {
+    int32_t dimension;
+    float splitValue;
+    uint32_t leaf;
+    uint32_t eventCount;  ///< live events of a leaf
+};
+}
+
 KDTree::KDTree() : root(nullptr) {}
 
-void KDTree::buildBalanced(std::vector<CollisionEvent>& events) {
+KDTree::~KDTree() {
+    release();
+}
+
+void KDTree::build(std::vector<CollisionEvent>& events) {
+    locator.clear();
+    locatorBuilt = false;
+    assign(events, false);
+}
+
+void KDTree::assign(std::vector<CollisionEvent>& events, bool take) {
     // Sort events by restEnergyOut since kineticEnergyIn is constant
     std::sort(events.begin(), events.end(), [](const CollisionEvent& a, const CollisionEvent& b) {
         return a.restEnergyOut < b.restEnergyOut;
     });
-    root = buildRecursive(events, 0);
+    liveCount = builtCount = events.size();
+    deletedCount = insertedCount = 0;
+    release();
+    root = buildRecursive(events, 0, events.size(), take);
 }
 
-std::unique_ptr<Node> KDTree::buildRecursive(std::vector<CollisionEvent>& events, int depth) {
-    if (events.empty()) return nullptr;
-    if (events.size() <= bucketSize) {
-        auto node = std::make_unique<Node>();
-        node->events = std::move(events);
+Node* KDTree::buildRecursive(std::vector<CollisionEvent>& events, size_t begin, size_t end, bool take) {
+    if (begin == end) return nullptr;
+    Node* node = arena.make<Node>(arena);
+    if (end - begin <= bucketSize) {
+        // Each event is copied once, straight into its leaf; a rebuild moves its own copies instead
+        node->events.reserve(end - begin);
+        node->keys.reserve(end - begin);
+        for (size_t k = begin; k < end; ++k) {
+            if (take) node->events.push_back(std::move(events[k]));
+            else node->events.push_back(events[k]);
+            node->keys.push_back(node->events.back().restEnergyOut);
+            node->summary.add(node->events.back());
+        }
         return node;
     }
 
-    int dim = 1; // Always split on restEnergyOut since kineticEnergyIn is constant
-    size_t median = events.size() / 2;
-    std::nth_element(events.begin(), events.begin() + median, events.end(),
+    // The range is sorted, so the median is its middle
+    size_t median = begin + (end - begin) / 2;
+    node->dimension = 1; // Always split on restEnergyOut since kineticEnergyIn is constant
+    node->splitValue = events[median].restEnergyOut;
+
+    // The median itself goes right: left keys <= splitValue <= right keys
+    node->left = buildRecursive(events, begin, median, take);
+    node->right = buildRecursive(events, median, end, take);
+    node->summary = node->left->summary;
+    node->summary.merge(node->right->summary);
+
+    return node;
+}
+
+void KDTree::release() {
+    // Events still own their strings and are destroyed one by one; node memory goes back in one step
+    std::vector<Node*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        if (node->left) stack.push_back(node->left);
+        if (node->right) stack.push_back(node->right);
+        node->~Node();
+    }
+    root = nullptr;
+    arena.reset();
+}
+
+void KDTree::insert(const CollisionEvent& event) {
+    if (!root) root = arena.make<Node>(arena);
+    Node* node = root;
+    // Internal nodes always have both children; equal keys go right
+    while (node->left || node->right) {
+        node->summary.add(event);
+        node = (event.restEnergyOut < node->splitValue) ? node->left : node->right;
+    }
+    node->summary.add(event);
+    node->events.push_back(event);
+    node->keys.push_back(event.restEnergyOut);
+    ++liveCount;
+    ++insertedCount;
+    if (locatorBuilt) locator[event.eventId] = event.restEnergyOut;
+
+    if (node->events.size() > 2 * bucketSize) splitLeaf(node);
+    if (insertedCount > std::max(builtCount, bucketSize)) rebuild();
+}
+
+void KDTree::splitLeaf(Node* leaf) {
+    // Drop erased events first so they never propagate into new leaves
+    std::vector<CollisionEvent> live;
+    for (size_t k = 0; k < leaf->events.size(); ++k) {
+        if (std::isnan(leaf->keys[k])) --deletedCount;
+        else live.push_back(std::move(leaf->events[k]));
+    }
+    leaf->events.clear();
+    leaf->keys.clear();
+    if (live.size() <= bucketSize) {
+        for (auto& e : live) {
+            leaf->keys.push_back(e.restEnergyOut);
+            leaf->events.push_back(std::move(e));
+        }
+        return;
+    }
+    // The leaf becomes internal; its buckets go back to the arena for the children to reuse
+    leaf->events.shrink_to_fit();
+    leaf->keys.shrink_to_fit();
+
+    size_t median = live.size() / 2;
+    std::nth_element(live.begin(), live.begin() + median, live.end(),
                      [](const CollisionEvent& a, const CollisionEvent& b) {
                          return a.restEnergyOut < b.restEnergyOut;
                      });
+    leaf->dimension = 1;
+    leaf->splitValue = live[median].restEnergyOut;
+    leaf->left = arena.make<Node>(arena);
+    leaf->right = arena.make<Node>(arena);
+    for (size_t k = 0; k < live.size(); ++k) {
+        Node* child = (k < median) ? leaf->left : leaf->right;
+        child->summary.add(live[k]);
+        child->keys.push_back(live[k].restEnergyOut);
+        child->events.push_back(std::move(live[k]));
+    }
+}
 
-    auto node = std::make_unique<Node>();
-    node->dimension = dim;
-    node->splitValue = events[median].restEnergyOut;
+bool KDTree::erase(int eventId) {
+    if (!locatorBuilt) buildLocator();
+    auto it = locator.find(eventId);
+    if (it == locator.end() || !eraseRecursive(root, eventId, it->second)) return false;
+    locator.erase(it);
+    --liveCount;
+    ++deletedCount;
+    // Marked events slow every scan they sit in; rebuild once they exceed a quarter of the live ones
+    if (deletedCount * 4 > liveCount) rebuild();
+    return true;
+}
 
-    std::vector<CollisionEvent> leftEvents(events.begin(), events.begin() + median);
-    std::vector<CollisionEvent> rightEvents(events.begin() + median + 1, events.end());
+bool KDTree::eraseRecursive(Node* node, int eventId, float key) {
+    if (!node) return false;
+    if (node->left || node->right) {
+        // Keys equal to the split may sit on either side
+        if (!(key <= node->splitValue && eraseRecursive(node->left, eventId, key)) &&
+            !(key >= node->splitValue && eraseRecursive(node->right, eventId, key)))
+            return false;
+        // Re-merge from the children so extrema stay exact, not just the sums
+        node->summary = node->left->summary;
+        node->summary.merge(node->right->summary);
+        return true;
+    }
+    for (size_t k = 0; k < node->events.size(); ++k) {
+        if (!std::isnan(node->keys[k]) && node->events[k].eventId == eventId) {
+            node->keys[k] = std::numeric_limits<float>::quiet_NaN();
+            node->summary = Aggregate();
+            for (size_t i = 0; i < node->events.size(); ++i) {
+                if (!std::isnan(node->keys[i])) node->summary.add(node->events[i]);
+            }
+            return true;
+        }
+    }
+    return false;
+}
 
-    node->left = buildRecursive(leftEvents, depth + 1);
-    node->right = buildRecursive(rightEvents, depth + 1);
+bool KDTree::update(const CollisionEvent& event) {
+    if (!erase(event.eventId)) return false;
+    insert(event);
+    return true;
+}
 
-    return node;
+void KDTree::collectLive(Node* node, std::vector<CollisionEvent>& out) {
+    if (!node) return;
+    for (size_t k = 0; k < node->events.size(); ++k) {
+        if (!std::isnan(node->keys[k])) out.push_back(std::move(node->events[k]));
+    }
+    collectLive(node->left, out);
+    collectLive(node->right, out);
 }
 
-void KDTree::insert(const CollisionEvent& event) {
-    // Kept for compatibility, but not used with buildBalanced
-    if (!root) {
-        root = std::make_unique<Node>();
-        root->events.push_back(event);
+void KDTree::buildLocator() {
+    locator.clear();
+    std::vector<const Node*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        for (size_t k = 0; k < node->events.size(); ++k) {
+            if (!std::isnan(node->keys[k])) locator[node->events[k].eventId] = node->keys[k];
+        }
+        if (node->left) stack.push_back(node->left);
+        if (node->right) stack.push_back(node->right);
     }
+    locatorBuilt = true;
 }
 
-std::vector<CollisionEvent> KDTree::range_query(float minRestEnergy, float maxRestEnergy) {
-    std::vector<CollisionEvent> result;
-    rangeQueryRecursive(root.get(), minRestEnergy, maxRestEnergy, result);
+void KDTree::rebuild() {
+    std::vector<CollisionEvent> live;
+    live.reserve(liveCount);
+    collectLive(root, live);
+    // The live set is unchanged, so the locator stays valid across the rebuild
+    assign(live, true);
+}
+
+QueryResult KDTree::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    rangeQueryRecursive(root, minRestEnergy, maxRestEnergy, result);
     return result;
 }
 
 void KDTree::rangeQueryRecursive(const Node* node, float minRestEnergy, float maxRestEnergy,
-                                 std::vector<CollisionEvent>& result) {
+                                 QueryResult& result) const {
     if (!node) return;
     if (node->left || node->right) {
         if (node->splitValue >= minRestEnergy)
-            rangeQueryRecursive(node->left.get(), minRestEnergy, maxRestEnergy, result);
+            rangeQueryRecursive(node->left, minRestEnergy, maxRestEnergy, result);
         if (node->splitValue <= maxRestEnergy)
-            rangeQueryRecursive(node->right.get(), minRestEnergy, maxRestEnergy, result);
+            rangeQueryRecursive(node->right, minRestEnergy, maxRestEnergy, result);
+    } else if (node->summary.count == node->keys.size() && node->summary.within(minRestEnergy, maxRestEnergy)) {
+        // No erased events and every key inside: the whole bucket matches
+        result.add(node->events.data(), node->events.size());
     } else {
-        for (const auto& e : node->events) {
-            if (e.restEnergyOut >= minRestEnergy && e.restEnergyOut <= maxRestEnergy)
-                result.push_back(e);
+        // Erased events have NaN keys and never match
+        forEachInRange(node->keys.data(), node->keys.size(), minRestEnergy, maxRestEnergy,
+                       [&](size_t k) { result.add(&node->events[k]); });
+    }
+}
+
+std::vector<QueryResult> KDTree::range_query_batch(const std::vector<RangeQuery>& queries) const {
+    std::vector<QueryResult> results(queries.size());
+    std::vector<size_t> order;
+    for (size_t q = 0; q < queries.size(); ++q) {
+        if (queries[q].minRestEnergy <= queries[q].maxRestEnergy) order.push_back(q);
+    }
+    // Sorted by lower bound, the windows reaching a left subtree are always a prefix
+    std::sort(order.begin(), order.end(), [&queries](size_t a, size_t b) {
+        return queries[a].minRestEnergy < queries[b].minRestEnergy;
+    });
+    rangeQueryBatchRecursive(root, queries, order.data(), order.size(), results);
+    return results;
+}
+
+void KDTree::rangeQueryBatchRecursive(const Node* node, const std::vector<RangeQuery>& queries,
+                                      const size_t* active, size_t count, std::vector<QueryResult>& results) const {
+    if (!node || count == 0) return;
+    if (node->left || node->right) {
+        size_t leftCount = 0;
+        while (leftCount < count && queries[active[leftCount]].minRestEnergy <= node->splitValue) ++leftCount;
+        rangeQueryBatchRecursive(node->left, queries, active, leftCount, results);
+
+        // Only copy the active list when some window ends before the right subtree
+        size_t first = 0;
+        while (first < count && queries[active[first]].maxRestEnergy >= node->splitValue) ++first;
+        if (first == count) {
+            rangeQueryBatchRecursive(node->right, queries, active, count, results);
+            return;
+        }
+        std::vector<size_t> right(active, active + first);
+        for (size_t k = first + 1; k < count; ++k) {
+            if (queries[active[k]].maxRestEnergy >= node->splitValue) right.push_back(active[k]);
+        }
+        rangeQueryBatchRecursive(node->right, queries, right.data(), right.size(), results);
+        return;
+    }
+    for (size_t q = 0; q < count; ++q) {
+        const RangeQuery& query = queries[active[q]];
+        QueryResult& result = results[active[q]];
+        if (node->summary.count == node->keys.size() && node->summary.within(query.minRestEnergy, query.maxRestEnergy)) {
+            result.add(node->events.data(), node->events.size());
+            continue;
+        }
+        forEachInRange(node->keys.data(), node->keys.size(), query.minRestEnergy, query.maxRestEnergy,
+                       [&](size_t k) { result.add(&node->events[k]); });
+    }
+}
+
+const CollisionEvent& KDTree::find_max_efficiency() const {
+    if (!root || root->summary.count == 0) throw std::runtime_error("Empty tree");
+    // Every summary holds its subtree's maximum, so descend into the child holding it, O(depth)
+    const Node* node = root;
+    while (node->left || node->right) {
+        bool left = node->left && (!node->right || node->left->summary.maxEfficiency >= node->right->summary.maxEfficiency);
+        node = left ? node->left : node->right;
+    }
+    const CollisionEvent* best = nullptr;
+    for (size_t k = 0; k < node->events.size(); ++k) {
+        if (!std::isnan(node->keys[k]) && (!best || node->events[k].efficiency > best->efficiency))
+            best = &node->events[k];
+    }
+    return *best;
+}
+
+Aggregate KDTree::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    if (minRestEnergy <= maxRestEnergy) aggregateRecursive(root, minRestEnergy, maxRestEnergy, result);
+    return result;
+}
+
+void KDTree::aggregateRecursive(const Node* node, float minRestEnergy, float maxRestEnergy,
+                                Aggregate& result) const {
+    if (!node || node->summary.disjoint(minRestEnergy, maxRestEnergy)) return;
+    if (node->summary.within(minRestEnergy, maxRestEnergy)) {
+        result.merge(node->summary);
+        return;
+    }
+    if (node->left || node->right) {
+        aggregateRecursive(node->left, minRestEnergy, maxRestEnergy, result);
+        aggregateRecursive(node->right, minRestEnergy, maxRestEnergy, result);
+        return;
+    }
+    forEachInRange(node->keys.data(), node->keys.size(), minRestEnergy, maxRestEnergy,
+                   [&](size_t k) { result.add(node->events[k]); });
+}
+
+QueryResult KDTree::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    TopK top(k);
+    if (!root || !(minRestEnergy <= maxRestEnergy)) return top.result();
+
+    // Best-first over subtrees, most promising efficiency bound on top
+    using Candidate = std::pair<float, const Node*>;
+    auto lessPromising = [](const Candidate& a, const Candidate& b) { return a.first < b.first; };
+    std::priority_queue<Candidate, std::vector<Candidate>, decltype(lessPromising)> frontier(lessPromising);
+    frontier.push({root->summary.maxEfficiency, root});
+    while (!frontier.empty() && top.admits(frontier.top().first)) {
+        const Node* node = frontier.top().second;
+        frontier.pop();
+        if (node->left || node->right) {
+            for (const Node* child : {node->left, node->right}) {
+                if (child && !child->summary.disjoint(minRestEnergy, maxRestEnergy))
+                    frontier.push({child->summary.maxEfficiency, child});
+            }
+            continue;
         }
+        forEachInRange(node->keys.data(), node->keys.size(), minRestEnergy, maxRestEnergy,
+                       [&](size_t i) { top.offer(&node->events[i]); });
     }
+    return top.result();
 }
 
-CollisionEvent KDTree::find_max_efficiency() {
-    return findMaxEfficiencyRecursive(root.get());
+MemoryUsage KDTree::memory_usage() const {
+    MemoryUsage usage;
+    std::vector<const Node*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        usage.payload += heapBytes(node->events) + heapBytes(node->keys);
+        usage.strings += stringBytes(node->events);
+        if (node->left) stack.push_back(node->left);
+        if (node->right) stack.push_back(node->right);
+    }
+    // The rest of the arena is nodes, spare block space and freed buckets awaiting reuse
+    usage.nodes = sizeof(*this) + arena.reserved() - usage.payload;
+    usage.heaps = heapBytes(locator);
+    return usage;
 }
 
-CollisionEvent KDTree::findMaxEfficiencyRecursive(const Node* node) {
-    if (!node) throw std::runtime_error("Empty tree");
-    if (!node->left && !node->right) {
-        return *std::max_element(node->events.begin(), node->events.end(),
-                                 [](const auto& a, const auto& b) { return a.efficiency < b.efficiency; });
+void KDTree::save_snapshot(const std::string& path, const SnapshotSource& source) const {
+    SnapshotWriter writer(SnapshotKind::KDTree, source);
+    writer.add_record<uint32_t>(root ? 1 : 0);
+    saveRecursive(root, writer);
+    writer.write(path);
+}
+
+void KDTree::saveRecursive(const Node* node, SnapshotWriter& writer) const {
+    if (!node) return;
+    if (node->left || node->right) {
+        writer.add_record(NodeRecord{node->dimension, node->splitValue, 0, 0});
+        saveRecursive(node->left, writer);
+        saveRecursive(node->right, writer);
+        return;
+    }
+    // Erased events are dropped; the leaf keeps its place in the tree
+    uint32_t live = 0;
+    for (size_t k = 0; k < node->events.size(); ++k) {
+        if (std::isnan(node->keys[k])) continue;
+        writer.add_event(node->events[k]);
+        ++live;
+    }
+    writer.add_record(NodeRecord{0, 0, 1, live});
+}
+
+void KDTree::load_snapshot(const SnapshotImage& image) {
+    if (image.kind() != SnapshotKind::KDTree) throw std::runtime_error("Not a KDTree snapshot");
+    release();
+    liveCount = builtCount = deletedCount = insertedCount = 0;
+    locator.clear();
+    locatorBuilt = false;
+    size_t offset = 0, nextEvent = 0;
+    try {
+        if (image.read<uint32_t>(offset)) loadRecursive(image, offset, nextEvent, root);
+        if (nextEvent != image.event_count()) throw std::runtime_error("Malformed snapshot");
+    } catch (const std::runtime_error&) {
+        // Every node restored so far hangs off root, so releasing the tree frees them
+        release();
+        throw;
     }
-    CollisionEvent leftMax = findMaxEfficiencyRecursive(node->left.get());
-    CollisionEvent rightMax = findMaxEfficiencyRecursive(node->right.get());
-    return (leftMax.efficiency > rightMax.efficiency) ? leftMax : rightMax;
-}
\ No newline at end of file
+    liveCount = builtCount = nextEvent;
+}
+
+void KDTree::loadRecursive(const SnapshotImage& image, size_t& offset, size_t& nextEvent, Node*& slot) {
+    NodeRecord record = image.read<NodeRecord>(offset);
+    Node* node = slot = arena.make<Node>(arena);
+    if (!record.leaf) {
+        node->dimension = record.dimension;
+        node->splitValue = record.splitValue;
+        loadRecursive(image, offset, nextEvent, node->left);
+        loadRecursive(image, offset, nextEvent, node->right);
+        node->summary = node->left->summary;
+        node->summary.merge(node->right->summary);
+        return;
+    }
+    // Leaves were written in preorder, so each takes the next eventCount events of the table
+    node->events.reserve(record.eventCount);
+    node->keys.reserve(record.eventCount);
+    for (uint32_t k = 0; k < record.eventCount; ++k) {
+        node->events.push_back(image.event(nextEvent++));
+        node->keys.push_back(node->events.back().restEnergyOut);
+        node->summary.add(node->events.back());
+    }
+}
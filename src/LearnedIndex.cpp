@@ -0,0 +1,314 @@
+#include "LearnedIndex.h"
+#include "TopK.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+LearnedIndex::LearnedIndex(size_t errorBound) : errorBound(errorBound) {}
+
+void LearnedIndex::build(std::vector<CollisionEvent>& events) {
+    std::sort(events.begin(), events.end(), [](const CollisionEvent& a, const CollisionEvent& b) {
+        return a.restEnergyOut < b.restEnergyOut;
+    });
+    this->events = events;
+    pending.clear();
+    locator.clear();
+    locatorBuilt = false;
+    train();
+}
+
+void LearnedIndex::train() {
+    keys.resize(events.size());
+    erased.assign(events.size(), false);
+    erasedCount = 0;
+    maxIndex = 0;
+    blockLeaves = 1;
+    while (blockLeaves * blockSize < events.size()) blockLeaves *= 2;
+    blockTree.assign(2 * blockLeaves, Aggregate());
+    for (size_t i = 0; i < events.size(); ++i) {
+        keys[i] = events[i].restEnergyOut;
+        if (events[i].efficiency > events[maxIndex].efficiency) maxIndex = i;
+        blockTree[blockLeaves + i / blockSize].add(events[i]);
+    }
+    for (size_t node = blockLeaves - 1; node >= 1; --node) {
+        blockTree[node] = blockTree[2 * node];
+        blockTree[node].merge(blockTree[2 * node + 1]);
+    }
+
+    // Greedy shrinking cone: extend each segment while some slope keeps every
+    // covered position within errorBound of its prediction.
+    segments.clear();
+    segmentKeys.clear();
+    const double eps = static_cast<double>(errorBound);
+    size_t i = 0;
+    while (i < keys.size()) {
+        size_t start = i;
+        double slopeLo = 0.0, slopeHi = std::numeric_limits<double>::infinity();
+        size_t j = start + 1;
+        for (; j < keys.size(); ++j) {
+            double dx = static_cast<double>(keys[j]) - keys[start];
+            double dy = static_cast<double>(j - start);
+            if (dx == 0.0) {
+                if (dy > eps) break;
+                continue;
+            }
+            double lo = std::max(slopeLo, (dy - eps) / dx);
+            double hi = std::min(slopeHi, (dy + eps) / dx);
+            if (lo > hi) break;
+            slopeLo = lo;
+            slopeHi = hi;
+        }
+        double slope = std::isinf(slopeHi) ? 0.0 : (slopeLo + slopeHi) / 2;
+        segments.push_back({keys[start], static_cast<float>(slope), start});
+        segmentKeys.push_back(keys[start]);
+        i = j;
+    }
+}
+
+size_t LearnedIndex::lowerBound(float key) const {
+    if (segments.empty()) return 0;
+    // Last segment starting below key; the first occurrence of key lies in it or at the next start
+    auto it = std::lower_bound(segmentKeys.begin(), segmentKeys.end(), key);
+    const Segment& seg = segments[it == segmentKeys.begin() ? 0 : (it - segmentKeys.begin()) - 1];
+
+    double predicted = seg.start + static_cast<double>(seg.slope) * (key - seg.firstKey);
+    // An infinite key on a flat segment predicts 0 * inf; the checked search below still finds it
+    if (std::isnan(predicted)) predicted = 0;
+    predicted = std::clamp(predicted, 0.0, static_cast<double>(keys.size()));
+    size_t pos = static_cast<size_t>(predicted);
+    size_t lo = pos > errorBound + 1 ? pos - errorBound - 1 : 0;
+    size_t hi = std::min(keys.size(), pos + errorBound + 2);
+    size_t result = std::lower_bound(keys.begin() + lo, keys.begin() + hi, key) - keys.begin();
+
+    // The bound is exact for trained keys; fall back to a full search for the rest
+    bool valid = (result == 0 || keys[result - 1] < key) && (result == keys.size() || keys[result] >= key);
+    if (!valid) result = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    return result;
+}
+
+size_t LearnedIndex::upperBound(float key) const {
+    // nextafter cannot step past +infinity, and every key is <= it
+    if (key == std::numeric_limits<float>::infinity()) return keys.size();
+    return lowerBound(std::nextafter(key, std::numeric_limits<float>::infinity()));
+}
+
+void LearnedIndex::insert(const CollisionEvent& event) {
+    auto it = std::upper_bound(pending.begin(), pending.end(), event.restEnergyOut,
+                               [](float key, const CollisionEvent& e) { return key < e.restEnergyOut; });
+    size_t pos = it - pending.begin();
+    pending.insert(it, event);
+    if (locatorBuilt) locator[event.eventId] = event.restEnergyOut;
+    if (pending.size() == 1) {
+        pendingMaxIndex = 0;
+    } else {
+        if (pos <= pendingMaxIndex) ++pendingMaxIndex;
+        if (event.efficiency > pending[pendingMaxIndex].efficiency) pendingMaxIndex = pos;
+    }
+    if (pending.size() >= pendingLimit) mergePending();
+}
+
+void LearnedIndex::mergePending() {
+    // Retraining is also when erased events are finally dropped
+    if (erasedCount) {
+        size_t kept = 0;
+        for (size_t i = 0; i < events.size(); ++i) {
+            if (!erased[i]) events[kept++] = std::move(events[i]);
+        }
+        events.resize(kept);
+    }
+    std::vector<CollisionEvent> merged;
+    merged.reserve(events.size() + pending.size());
+    std::merge(std::make_move_iterator(events.begin()), std::make_move_iterator(events.end()),
+               std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.end()),
+               std::back_inserter(merged),
+               [](const CollisionEvent& a, const CollisionEvent& b) { return a.restEnergyOut < b.restEnergyOut; });
+    events = std::move(merged);
+    pending.clear();
+    train();
+}
+
+void LearnedIndex::resetPendingMax() {
+    pendingMaxIndex = 0;
+    for (size_t i = 1; i < pending.size(); ++i) {
+        if (pending[i].efficiency > pending[pendingMaxIndex].efficiency) pendingMaxIndex = i;
+    }
+}
+
+void LearnedIndex::refreshBlock(size_t block) {
+    size_t node = blockLeaves + block;
+    blockTree[node] = Aggregate();
+    for (size_t i = block * blockSize; i < std::min(events.size(), (block + 1) * blockSize); ++i) {
+        if (!erased[i]) blockTree[node].add(events[i]);
+    }
+    for (node /= 2; node >= 1; node /= 2) {
+        blockTree[node] = blockTree[2 * node];
+        blockTree[node].merge(blockTree[2 * node + 1]);
+    }
+}
+
+void LearnedIndex::buildLocator() {
+    locator.clear();
+    locator.reserve(events.size() + pending.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (!erased[i]) locator[events[i].eventId] = keys[i];
+    }
+    for (const auto& e : pending) locator[e.eventId] = e.restEnergyOut;
+    locatorBuilt = true;
+}
+
+bool LearnedIndex::erase(int eventId) {
+    if (!locatorBuilt) buildLocator();
+    auto it = locator.find(eventId);
+    if (it == locator.end()) return false;
+    float key = it->second;
+
+    auto lo = std::lower_bound(pending.begin(), pending.end(), key,
+                               [](const CollisionEvent& e, float k) { return e.restEnergyOut < k; });
+    for (; lo != pending.end() && lo->restEnergyOut == key; ++lo) {
+        if (lo->eventId != eventId) continue;
+        pending.erase(lo);
+        resetPendingMax();
+        locator.erase(it);
+        return true;
+    }
+
+    for (size_t pos = lowerBound(key); pos < keys.size() && keys[pos] == key; ++pos) {
+        if (erased[pos] || events[pos].eventId != eventId) continue;
+        erased[pos] = true;
+        ++erasedCount;
+        locator.erase(it);
+        if (erasedCount * 8 > events.size()) {
+            mergePending();
+            return true;
+        }
+        refreshBlock(pos / blockSize);
+        if (pos == maxIndex) {
+            for (size_t i = 0; i < events.size(); ++i) {
+                if (!erased[i] && (erased[maxIndex] || events[i].efficiency > events[maxIndex].efficiency))
+                    maxIndex = i;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool LearnedIndex::update(const CollisionEvent& event) {
+    if (!erase(event.eventId)) return false;
+    insert(event);
+    return true;
+}
+
+QueryResult LearnedIndex::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    size_t first = lowerBound(minRestEnergy);
+    size_t last = std::max(first, upperBound(maxRestEnergy));
+    if (erasedCount == 0) {
+        result.add(events.data() + first, last - first);
+    } else {
+        for (size_t i = first; i < last; ++i) {
+            if (!erased[i]) result.add(&events[i]);
+        }
+    }
+
+    auto lo = std::lower_bound(pending.begin(), pending.end(), minRestEnergy,
+                               [](const CollisionEvent& e, float key) { return e.restEnergyOut < key; });
+    auto hi = std::upper_bound(lo, pending.end(), maxRestEnergy,
+                               [](float key, const CollisionEvent& e) { return key < e.restEnergyOut; });
+    result.add(pending.data() + (lo - pending.begin()), hi - lo);
+    return result;
+}
+
+const CollisionEvent& LearnedIndex::find_max_efficiency() const {
+    bool noEvents = events.size() == erasedCount;
+    if (noEvents && pending.empty()) throw std::runtime_error("Empty index");
+    if (noEvents) return pending[pendingMaxIndex];
+    if (pending.empty()) return events[maxIndex];
+    return pending[pendingMaxIndex].efficiency > events[maxIndex].efficiency ? pending[pendingMaxIndex]
+                                                                             : events[maxIndex];
+}
+
+QueryResult LearnedIndex::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    TopK top(k);
+    if (!(minRestEnergy <= maxRestEnergy)) return top.result();
+    size_t first = lowerBound(minRestEnergy);
+    size_t last = std::max(first, upperBound(maxRestEnergy));
+
+    // Blocks overlapping [first, last), most promising first
+    std::vector<size_t> blocks;
+    for (size_t b = first / blockSize; b * blockSize < last; ++b) blocks.push_back(b);
+    auto blockMax = [this](size_t b) { return blockTree[blockLeaves + b].maxEfficiency; };
+    auto lessPromising = [&blockMax](size_t a, size_t b) { return blockMax(a) < blockMax(b); };
+    std::make_heap(blocks.begin(), blocks.end(), lessPromising);
+    while (!blocks.empty() && top.admits(blockMax(blocks.front()))) {
+        std::pop_heap(blocks.begin(), blocks.end(), lessPromising);
+        size_t b = blocks.back();
+        blocks.pop_back();
+        size_t end = std::min(last, (b + 1) * blockSize);
+        for (size_t i = std::max(first, b * blockSize); i < end; ++i) {
+            if (!erased[i]) top.offer(&events[i]);
+        }
+    }
+
+    // The insert buffer is small; scan its part of the window
+    auto lo = std::lower_bound(pending.begin(), pending.end(), minRestEnergy,
+                               [](const CollisionEvent& e, float key) { return e.restEnergyOut < key; });
+    for (; lo != pending.end() && lo->restEnergyOut <= maxRestEnergy; ++lo) top.offer(&*lo);
+    return top.result();
+}
+
+Aggregate LearnedIndex::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    size_t first = lowerBound(minRestEnergy);
+    size_t last = std::max(first, upperBound(maxRestEnergy));
+
+    // Whole blocks come from the tree; only the ragged ends are scanned
+    size_t fullFirst = (first + blockSize - 1) / blockSize;
+    size_t fullLast = last / blockSize;
+    auto scan = [&](size_t from, size_t to) {
+        for (size_t i = from; i < to; ++i) {
+            if (!erased[i]) result.add(events[i]);
+        }
+    };
+    if (fullFirst >= fullLast) {
+        scan(first, last);
+    } else {
+        scan(first, fullFirst * blockSize);
+        scan(fullLast * blockSize, last);
+        for (size_t lo = blockLeaves + fullFirst, hi = blockLeaves + fullLast; lo < hi; lo /= 2, hi /= 2) {
+            if (lo & 1) result.merge(blockTree[lo++]);
+            if (hi & 1) result.merge(blockTree[--hi]);
+        }
+    }
+
+    auto lo = std::lower_bound(pending.begin(), pending.end(), minRestEnergy,
+                               [](const CollisionEvent& e, float key) { return e.restEnergyOut < key; });
+    for (; lo != pending.end() && lo->restEnergyOut <= maxRestEnergy; ++lo) result.add(*lo);
+    return result;
+}
+
+MemoryUsage LearnedIndex::memory_usage() const {
+    MemoryUsage usage;
+    usage.nodes = sizeof(*this) + heapBytes(segments) + heapBytes(segmentKeys) + heapBytes(blockTree) + heapBytes(erased);
+    usage.payload = heapBytes(events) + heapBytes(keys) + heapBytes(pending);
+    usage.strings = stringBytes(events) + stringBytes(pending);
+    usage.heaps = heapBytes(locator);
+    return usage;
+}
+
+std::vector<RangeQuery> LearnedIndex::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    if (!(minRestEnergy <= maxRestEnergy) || parts < 2) return {{minRestEnergy, maxRestEnergy}};
+    // Positions are known exactly, so cut the sorted column into equal slices
+    size_t first = lowerBound(minRestEnergy);
+    size_t last = std::max(first, upperBound(maxRestEnergy));
+    std::vector<float> cuts;
+    for (size_t p = 1; p < parts; ++p) {
+        size_t pos = first + (last - first) * p / parts;
+        if (pos > first && pos < last) cuts.push_back(keys[pos]);
+    }
+    return windowsFromCuts(minRestEnergy, maxRestEnergy, cuts);
+}
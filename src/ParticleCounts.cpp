@@ -0,0 +1,47 @@
+#include "ParticleCounts.h"
+#include <cstring>
+
+namespace {
+const char* const names[NumParticleTypes] = {"electron", "muon", "photon", "jet", "tau"};
+}
+
+int ParticleCounts::total() const {
+    int sum = 0;
+    for (int c : counts) sum += c;
+    return sum;
+}
+
+ParticleCounts countParticles(const std::string& outgoingParticles) {
+    ParticleCounts result;
+    // Strings come from fixed-width records, so stop at the first NUL and skip padding
+    const char* p = outgoingParticles.c_str();
+    while (*p) {
+        while (*p == ' ' || *p == ',') ++p;
+        const char* start = p;
+        while (*p && *p != ',' && *p != ' ') ++p;
+        size_t len = p - start;
+        if (len == 0) continue;
+        for (int t = 0; t < NumParticleTypes; ++t) {
+            if (std::strlen(names[t]) == len && std::strncmp(names[t], start, len) == 0) {
+                ++result.counts[t];
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+const char* particleName(ParticleType type) {
+    return names[type];
+}
+
+std::string signatureName(const ParticleCounts& counts) {
+    std::string name;
+    for (int t = 0; t < NumParticleTypes; ++t) {
+        for (int n = 0; n < counts.counts[t]; ++n) {
+            if (!name.empty()) name += ',';
+            name += names[t];
+        }
+    }
+    return name;
+}
@@ -0,0 +1,176 @@
+#include "QuantileSketch.h"
+#include "MemoryUsage.h"
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+/// Merges sorted values into the sorted vector into, from the back so no buffer is needed.
+void mergeSorted(std::vector<float>& into, const float* values, size_t count) {
+    size_t a = into.size(), b = count, out = a + count;
+    into.resize(out);
+    while (b > 0) {
+        if (a > 0 && into[a - 1] > values[b - 1]) into[--out] = into[--a];
+        else into[--out] = values[--b];
+    }
+}
+}
+
+QuantileSketch::QuantileSketch(size_t k) : k(std::max<size_t>(k, 8)) {
+    grow(1);
+}
+
+void QuantileSketch::grow(size_t height) {
+    levels.resize(height);
+    // Capacity shrinks by 2/3 per level below the top, never under 2
+    capacities.resize(height);
+    flushAt = 0;
+    for (size_t h = 0; h < height; ++h) {
+        capacities[h] = std::max<size_t>(2, static_cast<size_t>(std::ceil(k * std::pow(2.0 / 3.0, height - 1 - h))));
+        flushAt += capacities[h];
+    }
+}
+
+void QuantileSketch::add(float value) {
+    if (std::isnan(value)) return;
+    ++n;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+    levels[0].push_back(value);
+    if (++stored >= flushAt) compress();
+}
+
+void QuantileSketch::compress() {
+    // Lazy compaction: only the lowest full level, and only while the sketch as a whole is full
+    while (stored >= flushAt) {
+        size_t h = 0;
+        while (levels[h].size() < capacities[h]) ++h;
+        if (h + 1 == levels.size()) grow(h + 2);
+        std::vector<float>& level = levels[h];
+        if (h == 0) std::sort(level.begin(), level.end());
+        // An odd value out stays behind so the total weight is preserved exactly
+        size_t keep = level.size() % 2;
+        float odd = level.back();
+        coin ^= coin << 13;
+        coin ^= coin >> 7;
+        coin ^= coin << 17;
+        size_t promoted = 0;
+        for (size_t i = coin & 1; i + keep < level.size(); i += 2) level[promoted++] = level[i];
+        mergeSorted(levels[h + 1], level.data(), promoted);
+        stored -= level.size() - keep - promoted;
+        if (keep) level[0] = odd;
+        level.resize(keep);
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.n == 0) return;
+    n += other.n;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    if (levels.size() < other.levels.size()) grow(other.levels.size());
+    for (size_t h = 0; h < other.levels.size(); ++h) {
+        if (h == 0) levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+        else mergeSorted(levels[h], other.levels[h].data(), other.levels[h].size());
+    }
+    stored += other.stored;
+    compress();
+}
+
+std::vector<std::pair<float, uint64_t>> QuantileSketch::weighted() const {
+    std::vector<std::pair<float, uint64_t>> items;
+    items.reserve(stored);
+    for (size_t h = 0; h < levels.size(); ++h) {
+        for (float value : levels[h]) items.push_back({value, uint64_t(1) << h});
+    }
+    std::sort(items.begin(), items.end());
+    return items;
+}
+
+float QuantileSketch::quantile(double q) const {
+    return quantiles({q}).front();
+}
+
+std::vector<float> QuantileSketch::quantiles(const std::vector<double>& qs) const {
+    if (n == 0) throw std::runtime_error("Empty sketch");
+    std::vector<std::pair<float, uint64_t>> items = weighted();
+    uint64_t total = 0;
+    for (const auto& item : items) total += item.second;
+    std::vector<float> result;
+    result.reserve(qs.size());
+    for (double q : qs) {
+        if (!(q > 0)) {
+            result.push_back(minValue);
+            continue;
+        }
+        if (q >= 1) {
+            result.push_back(maxValue);
+            continue;
+        }
+        // First retained value whose cumulative weight reaches q of the total
+        double target = q * total;
+        uint64_t seen = 0;
+        float value = maxValue;
+        for (const auto& item : items) {
+            seen += item.second;
+            if (seen >= target) {
+                value = item.first;
+                break;
+            }
+        }
+        result.push_back(value);
+    }
+    return result;
+}
+
+double QuantileSketch::rank(float value) const {
+    uint64_t below = 0, total = 0;
+    for (size_t h = 0; h < levels.size(); ++h) {
+        for (float v : levels[h]) {
+            total += uint64_t(1) << h;
+            if (v <= value) below += uint64_t(1) << h;
+        }
+    }
+    return total ? static_cast<double>(below) / total : 0.0;
+}
+
+size_t QuantileSketch::heap_bytes() const {
+    size_t bytes = heapBytes(levels) + heapBytes(capacities);
+    for (const auto& level : levels) bytes += heapBytes(level);
+    return bytes;
+}
+
+void QuantileSketch::write(std::ostream& out) const {
+    uint64_t header[3] = {k, n, levels.size()};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&minValue), sizeof(minValue));
+    out.write(reinterpret_cast<const char*>(&maxValue), sizeof(maxValue));
+    for (const auto& level : levels) {
+        uint64_t size = level.size();
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.write(reinterpret_cast<const char*>(level.data()), size * sizeof(float));
+    }
+}
+
+QuantileSketch QuantileSketch::read(std::istream& in) {
+    uint64_t header[3];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!in || header[2] == 0 || header[2] > 64) throw std::runtime_error("Malformed quantile sketch");
+    QuantileSketch sketch(header[0]);
+    sketch.n = header[1];
+    in.read(reinterpret_cast<char*>(&sketch.minValue), sizeof(sketch.minValue));
+    in.read(reinterpret_cast<char*>(&sketch.maxValue), sizeof(sketch.maxValue));
+    sketch.grow(header[2]);
+    for (auto& level : sketch.levels) {
+        uint64_t size = 0;
+        in.read(reinterpret_cast<char*>(&size), sizeof(size));
+        if (!in || size > sketch.n) throw std::runtime_error("Malformed quantile sketch");
+        level.resize(size);
+        sketch.stored += size;
+        in.read(reinterpret_cast<char*>(level.data()), size * sizeof(float));
+    }
+    if (!in) throw std::runtime_error("Truncated quantile sketch");
+    return sketch;
+}
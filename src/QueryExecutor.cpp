@@ -0,0 +1,61 @@
+#include "QueryExecutor.h"
+#include <algorithm>
+
+QueryExecutor::QueryExecutor(unsigned int threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int t = 0; t < threads; ++t) workers.emplace_back(&QueryExecutor::work, this);
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard<std::mutex> guard(jobsMutex);
+        stopping = true;
+    }
+    jobsReady.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void QueryExecutor::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> guard(jobsMutex);
+        jobs.push_back(std::move(job));
+    }
+    jobsReady.notify_one();
+}
+
+void QueryExecutor::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> guard(jobsMutex);
+            jobsReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+            // Drain queued work before stopping so no future is left unfulfilled
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+std::vector<QueryResult> QueryExecutor::range_query_all(const DataStructure& ds,
+                                                        const std::vector<RangeQuery>& queries) {
+    std::vector<std::future<QueryResult>> pending;
+    pending.reserve(queries.size());
+    for (const RangeQuery& q : queries)
+        pending.push_back(submit([&ds, q] { return ds.range_query_view(q.minRestEnergy, q.maxRestEnergy); }));
+    std::vector<QueryResult> results;
+    results.reserve(queries.size());
+    for (auto& future : pending) results.push_back(future.get());
+    return results;
+}
+
+QueryResult QueryExecutor::range_query_parallel(const DataStructure& ds, float minRestEnergy, float maxRestEnergy) {
+    // Narrow windows are cheaper to answer on the calling thread than to hand out
+    size_t parts = std::min(workers.size(), ds.aggregate(minRestEnergy, maxRestEnergy).count / minEventsPerTask);
+    if (parts < 2) return ds.range_query_view(minRestEnergy, maxRestEnergy);
+    std::vector<RangeQuery> windows = ds.partition(minRestEnergy, maxRestEnergy, parts);
+    QueryResult result;
+    for (const QueryResult& part : range_query_all(ds, windows)) result.append(part);
+    return result;
+}
@@ -0,0 +1,260 @@
+#include "QueryPlanner.h"
+#include "ColumnScan.h"
+#include "GridBucketing.h"
+#include "KDTree.h"
+#include "LearnedIndex.h"
+#include "ParticleCounts.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+/// Median wall time of a few runs of a query, in nanoseconds.
+template <typename Query>
+double timeQuery(Query&& query) {
+    const int runs = 5;
+    std::array<double, runs> times;
+    for (double& t : times) {
+        auto start = std::chrono::steady_clock::now();
+        query();
+        auto end = std::chrono::steady_clock::now();
+        t = std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    std::nth_element(times.begin(), times.begin() + runs / 2, times.end());
+    return times[runs / 2];
+}
+
+/// Least-squares line through (rows, time) samples, kept non-negative.
+CostModel fit(const std::vector<double>& rows, const std::vector<double>& times) {
+    double n = static_cast<double>(rows.size()), meanRows = 0, meanTime = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        meanRows += rows[i] / n;
+        meanTime += times[i] / n;
+    }
+    double covariance = 0, variance = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        covariance += (rows[i] - meanRows) * (times[i] - meanTime);
+        variance += (rows[i] - meanRows) * (rows[i] - meanRows);
+    }
+    CostModel model;
+    model.perRow = variance > 0 ? std::max(0.0, covariance / variance) : 0.0;
+    model.fixed = std::max(0.0, meanTime - model.perRow * meanRows);
+    return model;
+}
+}
+
+QueryPlanner::QueryPlanner(const CompositionIndex& bitmaps, const SignatureIndex& signatures,
+                           std::vector<AccessKind> paths) :
+    bitmaps(bitmaps), signatures(signatures), kinds(std::move(paths)) {
+    if (kinds.empty()) throw std::runtime_error("QueryPlanner needs at least one access path");
+}
+
+void QueryPlanner::build(std::vector<CollisionEvent>& events) {
+    std::vector<float> sortedKeys;
+    sortedKeys.reserve(events.size());
+    for (const auto& e : events) sortedKeys.push_back(e.restEnergyOut);
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    float lo = sortedKeys.empty() ? 0.0f : sortedKeys.front();
+    float hi = sortedKeys.empty() ? 1.0f : sortedKeys.back();
+    if (!(hi > lo)) hi = lo + 1.0f;
+
+    paths.clear();
+    for (AccessKind kind : kinds) {
+        switch (kind) {
+            case AccessKind::KDTree:
+                paths.push_back({"KDTree", std::make_unique<KDTree>(), {}});
+                break;
+            case AccessKind::GridBucketing:
+                paths.push_back({"GridBucketing", std::make_unique<GridBucketing>(lo, hi), {}});
+                break;
+            case AccessKind::LearnedIndex:
+                paths.push_back({"LearnedIndex", std::make_unique<LearnedIndex>(), {}});
+                break;
+            case AccessKind::ColumnScan:
+                paths.push_back({"ColumnScan", std::make_unique<ColumnScan>(), {}});
+                break;
+        }
+    }
+    for (AccessPath& path : paths) path.index->build(events);
+    locator.clear();
+    locator.reserve(events.size());
+    for (const auto& e : events) locator[e.eventId] = e.restEnergyOut;
+
+    histogramMin = lo;
+    binWidth = (hi - lo) / histogramBins;
+    histogram.assign(histogramBins, 0);
+    for (float key : sortedKeys) ++histogram[bin(key)];
+    modified = false;
+    calibrate(sortedKeys);
+}
+
+void QueryPlanner::calibrate(const std::vector<float>& sortedKeys) {
+    if (sortedKeys.empty()) return;
+    // Probe windows centred in the key distribution, from a handful of rows to all of them
+    std::vector<RangeQuery> probes;
+    std::vector<double> rows;
+    for (double fraction : {0.0005, 0.005, 0.05, 0.25, 1.0}) {
+        size_t width = std::max<size_t>(1, static_cast<size_t>(fraction * sortedKeys.size()));
+        size_t first = (sortedKeys.size() - width) / 2;
+        probes.push_back({sortedKeys[first], sortedKeys[first + width - 1]});
+        rows.push_back(static_cast<double>(width));
+    }
+
+    for (AccessPath& path : paths) {
+        const DataStructure& index = *path.index;
+        std::vector<double> rangeTimes, topKTimes, aggregateTimes;
+        for (const RangeQuery& q : probes) {
+            rangeTimes.push_back(timeQuery([&] { index.range_query_view(q.minRestEnergy, q.maxRestEnergy); }));
+            topKTimes.push_back(timeQuery([&] { index.top_k_in_range(100, q.minRestEnergy, q.maxRestEnergy); }));
+            aggregateTimes.push_back(timeQuery([&] { index.aggregate(q.minRestEnergy, q.maxRestEnergy); }));
+        }
+        path.costOf(QueryKind::Range) = fit(rows, rangeTimes);
+        path.costOf(QueryKind::TopK) = fit(rows, topKTimes);
+        path.costOf(QueryKind::Aggregate) = fit(rows, aggregateTimes);
+        path.costOf(QueryKind::Extremum).fixed = timeQuery([&] { index.find_max_efficiency(); });
+    }
+
+    // Composition plans, probed with a cut every event passes, so both return every row of the window
+    CompositionCut everything;
+    std::vector<double> filterTimes, signatureTimes;
+    for (const RangeQuery& q : probes) {
+        QueryResult window = choose(QueryKind::Range, q.minRestEnergy, q.maxRestEnergy)
+                                 .index->range_query_view(q.minRestEnergy, q.maxRestEnergy);
+        filterTimes.push_back(timeQuery([&] { bitmaps.select(everything).filter(window); }));
+        signatureTimes.push_back(
+            timeQuery([&] { signatures.range_query(everything, q.minRestEnergy, q.maxRestEnergy); }));
+    }
+    bitmapFilterCost = fit(rows, filterTimes);
+    signatureCost = fit(rows, signatureTimes);
+}
+
+size_t QueryPlanner::bin(float restEnergy) const {
+    if (!(restEnergy > histogramMin)) return 0;
+    float position = (restEnergy - histogramMin) / binWidth;
+    return position >= histogramBins - 1 ? histogramBins - 1 : static_cast<size_t>(position);
+}
+
+double QueryPlanner::estimate_rows(float minRestEnergy, float maxRestEnergy) const {
+    if (histogram.empty() || !(minRestEnergy <= maxRestEnergy)) return 0.0;
+    // Whole bins count fully, the two boundary bins by the fraction of their width covered
+    double rows = 0;
+    for (size_t b = bin(minRestEnergy), last = bin(maxRestEnergy); b <= last; ++b) {
+        double lo = histogramMin + b * static_cast<double>(binWidth), hi = lo + binWidth;
+        if (b == 0) lo = std::min<double>(lo, minRestEnergy);
+        if (b == histogramBins - 1) hi = std::max<double>(hi, maxRestEnergy);
+        double covered = std::min<double>(hi, maxRestEnergy) - std::max<double>(lo, minRestEnergy);
+        double fraction = covered / (hi - lo);
+        // An outer bin stretched to an unbounded window divides infinities; the window covers it
+        rows += histogram[b] * (std::isnan(fraction) ? 1.0 : std::clamp(fraction, 0.0, 1.0));
+    }
+    return rows;
+}
+
+const QueryPlanner::AccessPath& QueryPlanner::choose(QueryKind kind, float minRestEnergy, float maxRestEnergy) const {
+    if (paths.empty()) throw std::runtime_error("QueryPlanner used before build()");
+    double rows = kind == QueryKind::Extremum ? 0.0 : estimate_rows(minRestEnergy, maxRestEnergy);
+    const AccessPath* best = &paths.front();
+    for (const AccessPath& path : paths) {
+        if (path.costOf(kind).at(rows) < best->costOf(kind).at(rows)) best = &path;
+    }
+    return *best;
+}
+
+bool QueryPlanner::signaturesCheaper(const CompositionCut& cut, float minRestEnergy, float maxRestEnergy) const {
+    // The signature index holds row ids into the table as loaded, which the planner's mutations do not reach
+    if (modified) return false;
+    // Rows of the matching groups in the window: their share of all events, spread like the histogram
+    size_t total = 0, matching = 0;
+    for (const Signature& group : signatures.signatures()) {
+        total += group.count;
+        if (cut.matches(group.counts) && !group.summary.disjoint(minRestEnergy, maxRestEnergy)) matching += group.count;
+    }
+    double rows = estimate_rows(minRestEnergy, maxRestEnergy);
+    double returned = total ? rows * matching / total : 0.0;
+    double filterCost = choose(QueryKind::Range, minRestEnergy, maxRestEnergy).costOf(QueryKind::Range).at(rows) +
+                        bitmapFilterCost.at(rows);
+    return signatureCost.at(returned) < filterCost;
+}
+
+const char* QueryPlanner::explain(QueryKind kind, float minRestEnergy, float maxRestEnergy) const {
+    return choose(kind, minRestEnergy, maxRestEnergy).name;
+}
+
+std::string QueryPlanner::explain_composition(const CompositionCut& cut, float minRestEnergy,
+                                              float maxRestEnergy) const {
+    if (signaturesCheaper(cut, minRestEnergy, maxRestEnergy)) return "SignatureIndex";
+    return std::string(explain(QueryKind::Range, minRestEnergy, maxRestEnergy)) +
+           (modified ? " + particle filter" : " + bitmap filter");
+}
+
+void QueryPlanner::insert(const CollisionEvent& event) {
+    if (paths.empty()) throw std::runtime_error("QueryPlanner used before build()");
+    for (AccessPath& path : paths) path.index->insert(event);
+    ++histogram[bin(event.restEnergyOut)];
+    locator[event.eventId] = event.restEnergyOut;
+    modified = true;
+}
+
+bool QueryPlanner::erase(int eventId) {
+    auto it = locator.find(eventId);
+    if (it == locator.end()) return false;
+    --histogram[bin(it->second)];
+    locator.erase(it);
+    for (AccessPath& path : paths) path.index->erase(eventId);
+    modified = true;
+    return true;
+}
+
+bool QueryPlanner::update(const CollisionEvent& event) {
+    auto it = locator.find(event.eventId);
+    if (it == locator.end()) return false;
+    --histogram[bin(it->second)];
+    ++histogram[bin(event.restEnergyOut)];
+    it->second = event.restEnergyOut;
+    for (AccessPath& path : paths) path.index->update(event);
+    modified = true;
+    return true;
+}
+
+QueryResult QueryPlanner::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    return choose(QueryKind::Range, minRestEnergy, maxRestEnergy).index->range_query_view(minRestEnergy, maxRestEnergy);
+}
+
+const CollisionEvent& QueryPlanner::find_max_efficiency() const {
+    return choose(QueryKind::Extremum, 0, 0).index->find_max_efficiency();
+}
+
+QueryResult QueryPlanner::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    return choose(QueryKind::TopK, minRestEnergy, maxRestEnergy).index->top_k_in_range(k, minRestEnergy, maxRestEnergy);
+}
+
+Aggregate QueryPlanner::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    return choose(QueryKind::Aggregate, minRestEnergy, maxRestEnergy).index->aggregate(minRestEnergy, maxRestEnergy);
+}
+
+MemoryUsage QueryPlanner::memory_usage() const {
+    MemoryUsage usage;
+    usage.nodes = sizeof(*this) + heapBytes(paths) + heapBytes(kinds) + heapBytes(histogram);
+    usage.heaps = heapBytes(locator);
+    for (const AccessPath& path : paths) usage += path.index->memory_usage();
+    return usage;
+}
+
+std::vector<RangeQuery> QueryPlanner::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    return choose(QueryKind::Range, minRestEnergy, maxRestEnergy).index->partition(minRestEnergy, maxRestEnergy, parts);
+}
+
+QueryResult QueryPlanner::composition_query(const CompositionCut& cut, float minRestEnergy,
+                                            float maxRestEnergy) const {
+    if (signaturesCheaper(cut, minRestEnergy, maxRestEnergy)) return signatures.range_query(cut, minRestEnergy, maxRestEnergy);
+    QueryResult window = range_query_view(minRestEnergy, maxRestEnergy);
+    if (!modified) return bitmaps.select(cut).filter(window);
+    // The bitmaps describe the events as loaded; once mutated, test each event's own particles
+    QueryResult result;
+    result.keepAlive(window);
+    for (const CollisionEvent& event : window) {
+        if (cut.matches(countParticles(event.outgoingParticles))) result.add(&event);
+    }
+    return result;
+}
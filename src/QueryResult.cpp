@@ -0,0 +1,32 @@
+#include "QueryResult.h"
+#include <stdexcept>
+
+void QueryResult::append(const QueryResult& other) {
+    for (const Span& span : other.spans) add(span.first, span.count);
+    keepAlive(other);
+}
+
+const CollisionEvent& QueryResult::operator[](size_t index) const {
+    // Linear in the number of spans, which coalescing keeps small
+    for (const Span& span : spans) {
+        if (index < span.count) return span.first[index];
+        index -= span.count;
+    }
+    throw std::out_of_range("QueryResult index out of range");
+}
+
+std::vector<int> QueryResult::eventIds() const {
+    std::vector<int> ids;
+    ids.reserve(total);
+    for (const Span& span : spans) {
+        for (size_t k = 0; k < span.count; ++k) ids.push_back(span.first[k].eventId);
+    }
+    return ids;
+}
+
+std::vector<CollisionEvent> QueryResult::materialize() const {
+    std::vector<CollisionEvent> events;
+    events.reserve(total);
+    for (const Span& span : spans) events.insert(events.end(), span.first, span.first + span.count);
+    return events;
+}
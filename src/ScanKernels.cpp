@@ -0,0 +1,105 @@
+#include "ScanKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+using SelectKernel = size_t (*)(const float*, size_t, float, float, uint32_t*);
+
+/// Branch-free: every position is written, and the cursor only advances past matches.
+size_t selectScalar(const float* keys, size_t count, float minKey, float maxKey, uint32_t* out, size_t base) {
+    size_t found = 0;
+    for (size_t i = 0; i < count; ++i) {
+        out[found] = static_cast<uint32_t>(base + i);
+        found += (keys[i] >= minKey) & (keys[i] <= maxKey);
+    }
+    return found;
+}
+
+size_t selectPortable(const float* keys, size_t count, float minKey, float maxKey, uint32_t* out) {
+    return selectScalar(keys, count, minKey, maxKey, out, 0);
+}
+
+#ifdef SCAN_KERNELS_X86
+/// For each 8-bit comparison mask, the lanes it selects, packed to the front.
+struct CompressTable {
+    uint32_t lanes[256][8];
+
+    constexpr CompressTable() : lanes() {
+        for (int mask = 0; mask < 256; ++mask) {
+            int packed = 0;
+            for (int lane = 0; lane < 8; ++lane) {
+                if (mask >> lane & 1) lanes[mask][packed++] = lane;
+            }
+        }
+    }
+};
+constexpr CompressTable compressTable;
+
+// Full-width stores at out + found never pass out + i + lanes, so out needs no slack
+__attribute__((target("avx2,popcnt")))
+size_t selectAvx2(const float* keys, size_t count, float minKey, float maxKey, uint32_t* out) {
+    const __m256 lo = _mm256_set1_ps(minKey), hi = _mm256_set1_ps(maxKey);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i rows = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    size_t found = 0, i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 key = _mm256_loadu_ps(keys + i);
+        // Ordered comparisons are false for NaN
+        __m256 in = _mm256_and_ps(_mm256_cmp_ps(key, lo, _CMP_GE_OQ), _mm256_cmp_ps(key, hi, _CMP_LE_OQ));
+        unsigned mask = _mm256_movemask_ps(in);
+        __m256i order = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(compressTable.lanes[mask]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + found), _mm256_permutevar8x32_epi32(rows, order));
+        found += _mm_popcnt_u32(mask);
+        rows = _mm256_add_epi32(rows, step);
+    }
+    return found + selectScalar(keys + i, count - i, minKey, maxKey, out + found, i);
+}
+
+__attribute__((target("avx512f,popcnt")))
+size_t selectAvx512(const float* keys, size_t count, float minKey, float maxKey, uint32_t* out) {
+    const __m512 lo = _mm512_set1_ps(minKey), hi = _mm512_set1_ps(maxKey);
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i rows = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    size_t found = 0, i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 key = _mm512_loadu_ps(keys + i);
+        __mmask16 in = _mm512_mask_cmp_ps_mask(_mm512_cmp_ps_mask(key, lo, _CMP_GE_OQ), key, hi, _CMP_LE_OQ);
+        // Compress in a register and store whole: a masked compress-store is microcoded on some CPUs
+        _mm512_storeu_si512(out + found, _mm512_maskz_compress_epi32(in, rows));
+        found += _mm_popcnt_u32(in);
+        rows = _mm512_add_epi32(rows, step);
+    }
+    return found + selectScalar(keys + i, count - i, minKey, maxKey, out + found, i);
+}
+#endif
+
+struct Kernel {
+    SelectKernel select;
+    const char* name;
+};
+
+Kernel chooseKernel() {
+#ifdef SCAN_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return {selectAvx512, "AVX-512"};
+    if (__builtin_cpu_supports("avx2")) return {selectAvx2, "AVX2"};
+#endif
+    return {selectPortable, "scalar"};
+}
+
+const Kernel& kernel() {
+    static const Kernel chosen = chooseKernel();
+    return chosen;
+}
+}
+
+size_t selectInRange(const float* keys, size_t count, float minKey, float maxKey, uint32_t* out) {
+    return kernel().select(keys, count, minKey, maxKey, out);
+}
+
+const char* scanKernelName() {
+    return kernel().name;
+}
@@ -0,0 +1,195 @@
+#include "SharedIndex.h"
+#include "TopK.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+/// Counts at the head of the layout; the block aggregates and the two columns follow.
+struct SharedLayout {
+    uint64_t count;
+    uint64_t blockCount;
+};
+}
+
+std::unique_ptr<SharedSegment> SharedIndex::publish(const std::string& name, std::vector<CollisionEvent> events,
+                                                    const SnapshotSource& source) {
+    std::sort(events.begin(), events.end(), [](const CollisionEvent& a, const CollisionEvent& b) {
+        return a.restEnergyOut < b.restEnergyOut;
+    });
+    SnapshotWriter writer(SnapshotKind::SharedIndex, source);
+    size_t blockCount = (events.size() + blockSize - 1) / blockSize;
+    writer.add_record(SharedLayout{events.size(), blockCount});
+    for (size_t b = 0; b < blockCount; ++b) {
+        Aggregate block;
+        for (size_t i = b * blockSize; i < std::min(events.size(), (b + 1) * blockSize); ++i) block.add(events[i]);
+        writer.add_record(block);
+    }
+    for (const CollisionEvent& event : events) writer.add_record(event.restEnergyOut);
+    for (const CollisionEvent& event : events) writer.add_record(event.efficiency);
+    for (const CollisionEvent& event : events) writer.add_event(event);
+    return writer.publish(name);
+}
+
+SharedIndex::SharedIndex(const std::string& name, const SnapshotSource& expected, size_t decodedLimit) :
+    image(name, expected, true), decodedLimit(std::max<size_t>(1, decodedLimit)) {
+    if (image.kind() != SnapshotKind::SharedIndex) throw std::runtime_error("Not a shared index");
+    size_t offset = 0;
+    SharedLayout layout = image.read<SharedLayout>(offset);
+    if (layout.count != image.event_count() || layout.blockCount != (layout.count + blockSize - 1) / blockSize)
+        throw std::runtime_error("Malformed shared index");
+    count = layout.count;
+    blockCount = layout.blockCount;
+    blocks = image.view<Aggregate>(offset, blockCount);
+    offset += blockCount * sizeof(Aggregate);
+    keys = image.view<float>(offset, count);
+    efficiencies = image.view<float>(offset + count * sizeof(float), count);
+    decoded.resize(blockCount);
+}
+
+void SharedIndex::build(std::vector<CollisionEvent>&) {
+    throw std::runtime_error("Shared index is read-only");
+}
+
+void SharedIndex::insert(const CollisionEvent&) {
+    throw std::runtime_error("Shared index is read-only");
+}
+
+bool SharedIndex::erase(int) {
+    throw std::runtime_error("Shared index is read-only");
+}
+
+bool SharedIndex::update(const CollisionEvent&) {
+    throw std::runtime_error("Shared index is read-only");
+}
+
+size_t SharedIndex::decoded_blocks() const {
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    return cached.size();
+}
+
+std::shared_ptr<const CollisionEvent[]> SharedIndex::block(size_t b) const {
+    // Decoded under the lock so concurrent queries decode each block once
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    if (decoded[b]) return decoded[b];
+    size_t first = b * blockSize, size = std::min(count, first + blockSize) - first;
+    std::shared_ptr<CollisionEvent[]> rows(new CollisionEvent[size]);
+    for (size_t i = 0; i < size; ++i) rows[i] = image.event(first + i);
+    decoded[b] = rows;
+    cached.push_back(b);
+    // An evicted block lives on in the results still pinning it
+    if (cached.size() > decodedLimit) {
+        decoded[cached.front()].reset();
+        cached.pop_front();
+    }
+    return rows;
+}
+
+size_t SharedIndex::lowerBound(float restEnergy) const {
+    return std::lower_bound(keys, keys + count, restEnergy) - keys;
+}
+
+size_t SharedIndex::upperBound(float restEnergy) const {
+    return std::upper_bound(keys, keys + count, restEnergy) - keys;
+}
+
+QueryResult SharedIndex::range_query_view(float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    size_t lo = lowerBound(minRestEnergy), hi = upperBound(maxRestEnergy);
+    // One span per decoded block the window touches, each pinned by the result
+    while (lo < hi) {
+        size_t b = lo / blockSize, end = std::min(hi, (b + 1) * blockSize);
+        std::shared_ptr<const CollisionEvent[]> rows = block(b);
+        result.add(rows.get() + lo % blockSize, end - lo);
+        result.keep(std::move(rows));
+        lo = end;
+    }
+    return result;
+}
+
+const CollisionEvent& SharedIndex::find_max_efficiency() const {
+    if (count == 0) throw std::runtime_error("Empty index");
+    size_t best = 0;
+    for (size_t b = 1; b < blockCount; ++b) {
+        if (blocks[b].maxEfficiency > blocks[best].maxEfficiency) best = b;
+    }
+    size_t first = best * blockSize, last = std::min(count, first + blockSize);
+    size_t index = std::max_element(efficiencies + first, efficiencies + last) - efficiencies;
+    // The answer never changes and is returned by reference, so it is kept outside the evicting cache
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    if (!maxEvent) maxEvent = std::make_unique<CollisionEvent>(image.event(index));
+    return *maxEvent;
+}
+
+Aggregate SharedIndex::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    size_t lo = lowerBound(minRestEnergy), hi = upperBound(maxRestEnergy);
+    // Partial blocks are read from the columns, so nothing is decoded
+    CollisionEvent probe;
+    auto addRow = [&](size_t i) {
+        probe.restEnergyOut = keys[i];
+        probe.efficiency = efficiencies[i];
+        result.add(probe);
+    };
+    while (lo < hi && lo % blockSize != 0) addRow(lo++);
+    for (; lo + blockSize <= hi; lo += blockSize) result.merge(blocks[lo / blockSize]);
+    for (; lo < hi; ++lo) addRow(lo);
+    return result;
+}
+
+QueryResult SharedIndex::top_k_in_range(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    TopK top(k);
+    if (!(minRestEnergy <= maxRestEnergy)) return top.result();
+    size_t lo = lowerBound(minRestEnergy), hi = upperBound(maxRestEnergy);
+    if (lo >= hi) return top.result();
+
+    // Blocks best-first by their maxima; only blocks with rows that can enter the result are decoded
+    std::vector<std::shared_ptr<const CollisionEvent[]>> used;
+    size_t usedBlock = blockCount;
+    using Candidate = std::pair<float, size_t>;
+    std::vector<Candidate> frontier;
+    for (size_t b = lo / blockSize; b * blockSize < hi; ++b) frontier.push_back({blocks[b].maxEfficiency, b});
+    std::make_heap(frontier.begin(), frontier.end());
+    while (!frontier.empty() && top.admits(frontier.front().first)) {
+        size_t b = frontier.front().second;
+        std::pop_heap(frontier.begin(), frontier.end());
+        frontier.pop_back();
+        size_t end = std::min(hi, (b + 1) * blockSize);
+        for (size_t i = std::max(lo, b * blockSize); i < end; ++i) {
+            if (!top.admits(efficiencies[i])) continue;
+            if (usedBlock != b) {
+                used.push_back(block(b));
+                usedBlock = b;
+            }
+            top.offer(&used.back()[i % blockSize]);
+        }
+    }
+    QueryResult result = top.result();
+    for (auto& rows : used) result.keep(std::move(rows));
+    return result;
+}
+
+MemoryUsage SharedIndex::memory_usage() const {
+    MemoryUsage usage;
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    usage.nodes = sizeof(*this) + heapBytes(decoded) + cached.size() * sizeof(size_t);
+    for (size_t b : cached) {
+        size_t size = std::min(count, (b + 1) * blockSize) - b * blockSize;
+        usage.payload += size * sizeof(CollisionEvent);
+        for (size_t i = 0; i < size; ++i) usage.strings += stringBytes(decoded[b][i]);
+    }
+    if (maxEvent) {
+        usage.payload += sizeof(CollisionEvent);
+        usage.strings += stringBytes(*maxEvent);
+    }
+    return usage;
+}
+
+std::vector<RangeQuery> SharedIndex::partition(float minRestEnergy, float maxRestEnergy, size_t parts) const {
+    if (!(minRestEnergy <= maxRestEnergy) || parts < 2) return {{minRestEnergy, maxRestEnergy}};
+    size_t first = lowerBound(minRestEnergy), last = upperBound(maxRestEnergy);
+    std::vector<float> cuts;
+    for (size_t p = 1; p < parts && first < last; ++p) cuts.push_back(keys[first + (last - first) * p / parts]);
+    return windowsFromCuts(minRestEnergy, maxRestEnergy, cuts);
+}
@@ -0,0 +1,74 @@
+#include "SignatureIndex.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+void SignatureIndex::build(const std::vector<CollisionEvent>& events) {
+    if (events.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Too many events for 32-bit row ids");
+    table = &events;
+    groups.clear();
+    lookup.clear();
+    std::vector<size_t> groupOf(events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        ParticleCounts counts = countParticles(events[i].outgoingParticles);
+        auto [it, inserted] = lookup.emplace(counts, groups.size());
+        if (inserted) groups.push_back({counts, 0, 0, Aggregate()});
+        groupOf[i] = it->second;
+        ++groups[it->second].count;
+    }
+
+    // Counting sort into contiguous posting lists, then order each list by key
+    size_t offset = 0;
+    for (Signature& group : groups) {
+        group.first = offset;
+        offset += group.count;
+    }
+    std::vector<size_t> next(groups.size());
+    for (size_t g = 0; g < groups.size(); ++g) next[g] = groups[g].first;
+    rows.resize(events.size());
+    for (size_t i = 0; i < events.size(); ++i) rows[next[groupOf[i]]++] = static_cast<uint32_t>(i);
+
+    keys.resize(rows.size());
+    for (Signature& group : groups) {
+        auto begin = rows.begin() + group.first;
+        std::sort(begin, begin + group.count, [&events](uint32_t a, uint32_t b) {
+            return events[a].restEnergyOut < events[b].restEnergyOut;
+        });
+        for (size_t i = group.first; i < group.first + group.count; ++i) {
+            keys[i] = events[rows[i]].restEnergyOut;
+            group.summary.add(events[rows[i]]);
+        }
+    }
+}
+
+const Signature* SignatureIndex::find(const ParticleCounts& counts) const {
+    auto it = lookup.find(counts);
+    return it == lookup.end() ? nullptr : &groups[it->second];
+}
+
+QueryResult SignatureIndex::range_query(const ParticleCounts& counts, float minRestEnergy,
+                                        float maxRestEnergy) const {
+    QueryResult result;
+    const Signature* group = find(counts);
+    if (group && minRestEnergy <= maxRestEnergy) addWindow(*group, minRestEnergy, maxRestEnergy, result);
+    return result;
+}
+
+QueryResult SignatureIndex::range_query(const CompositionCut& cut, float minRestEnergy, float maxRestEnergy) const {
+    QueryResult result;
+    if (!(minRestEnergy <= maxRestEnergy)) return result;
+    for (const Signature& group : groups) {
+        if (cut.matches(group.counts)) addWindow(group, minRestEnergy, maxRestEnergy, result);
+    }
+    return result;
+}
+
+void SignatureIndex::addWindow(const Signature& group, float minRestEnergy, float maxRestEnergy,
+                               QueryResult& result) const {
+    auto begin = keys.begin() + group.first, end = begin + group.count;
+    auto lo = std::lower_bound(begin, end, minRestEnergy);
+    auto hi = std::upper_bound(lo, end, maxRestEnergy);
+    // Rows adjacent in the table still coalesce into one span
+    for (size_t i = lo - keys.begin(); i < static_cast<size_t>(hi - keys.begin()); ++i) result.add(&(*table)[rows[i]]);
+}
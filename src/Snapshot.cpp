@@ -0,0 +1,294 @@
+#include "Snapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char snapshotMagic[8] = {'A', 'T', 'L', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t snapshotVersion = 1;
+
+/// Offsets of the sections are rounded up to this, so records start aligned.
+uint64_t aligned(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path, bool sharedMemory) {
+    if (sharedMemory) {
+        mappingHandle = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+        if (!mappingHandle) throw std::runtime_error("Shared memory not found");
+        bytes = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        MEMORY_BASIC_INFORMATION info;
+        if (!bytes || !VirtualQuery(bytes, &info, sizeof(info))) {
+            if (bytes) UnmapViewOfFile(bytes);
+            CloseHandle(mappingHandle);
+            throw std::runtime_error("Cannot map shared memory");
+        }
+        // Views are page-granular; the image header records the exact size
+        length = info.RegionSize;
+        return;
+    }
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("File not found");
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0) return;
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle) bytes = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!bytes) {
+        if (mappingHandle) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw std::runtime_error("Cannot map file");
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+}
+
+SharedSegment::SharedSegment(const std::string& name, size_t size) : length(size) {
+    uint64_t wide = size;
+    mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(wide >> 32),
+                                       static_cast<DWORD>(wide), name.c_str());
+    if (!mappingHandle) throw std::runtime_error("Cannot create shared memory");
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mappingHandle);
+        throw std::runtime_error("Shared memory is still in use");
+    }
+    bytes = static_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, size));
+    if (!bytes) {
+        CloseHandle(mappingHandle);
+        throw std::runtime_error("Cannot map shared memory");
+    }
+}
+
+SharedSegment::~SharedSegment() {
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mappingHandle) CloseHandle(mappingHandle);
+}
+
+void SharedSegment::remove(const std::string&) {
+    // Named mappings disappear with their last handle
+}
+#else
+MappedFile::MappedFile(const std::string& path, bool sharedMemory) {
+    int fd = sharedMemory ? shm_open(path.c_str(), O_RDONLY, 0) : open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error(sharedMemory ? "Shared memory not found" : "File not found");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file");
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map file");
+        }
+        bytes = static_cast<const char*>(mapped);
+    }
+    // The mapping keeps the file alive; the descriptor is no longer needed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+}
+
+SharedSegment::SharedSegment(const std::string& name, size_t size) : length(size) {
+    // Unlinking first leaves sessions attached to an older image mapped to it, untouched
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot create shared memory");
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Cannot size shared memory");
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Cannot map shared memory");
+    }
+    bytes = static_cast<char*>(mapped);
+}
+
+SharedSegment::~SharedSegment() {
+    if (bytes) munmap(bytes, length);
+}
+
+void SharedSegment::remove(const std::string& name) {
+    shm_unlink(name.c_str());
+}
+#endif
+
+SnapshotSource SnapshotSource::of(const std::string& path) {
+    SnapshotSource source;
+    MappedFile file(path);
+    source.size = file.size();
+    std::error_code error;
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (!error) source.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+
+    // FNV-style mix a word at a time: the whole file is hashed, at memory speed
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + 8 <= file.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, file.data() + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < file.size(); ++i) hash = (hash ^ static_cast<unsigned char>(file.data()[i])) * 0x100000001b3ull;
+    source.checksum = hash;
+    return source;
+}
+
+SnapshotWriter::SnapshotWriter(SnapshotKind kind, const SnapshotSource& source) : kind(kind), source(source) {}
+
+uint32_t SnapshotWriter::intern(const std::string& text) {
+    auto it = pooled.find(text);
+    if (it != pooled.end()) return it->second;
+    if (strings.size() + sizeof(uint32_t) + text.size() > std::numeric_limits<uint32_t>::max())
+        throw std::runtime_error("Snapshot string pool too large");
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    uint32_t size = static_cast<uint32_t>(text.size());
+    const char* sizeBytes = reinterpret_cast<const char*>(&size);
+    strings.insert(strings.end(), sizeBytes, sizeBytes + sizeof(size));
+    strings.insert(strings.end(), text.begin(), text.end());
+    pooled.emplace(text, offset);
+    return offset;
+}
+
+void SnapshotWriter::add_event(const CollisionEvent& event) {
+    events.push_back({event.eventId, intern(event.incomingParticles), intern(event.outgoingParticles),
+                      event.kineticEnergyIn, event.restEnergyOut, event.efficiency});
+}
+
+SnapshotHeader SnapshotWriter::layout() const {
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+    header.version = snapshotVersion;
+    header.kind = kind;
+    header.source = source;
+    header.eventCount = events.size();
+    header.eventsOffset = aligned(sizeof(header));
+    header.stringsOffset = aligned(header.eventsOffset + events.size() * sizeof(EventRecord));
+    header.stringsSize = strings.size();
+    header.recordsOffset = aligned(header.stringsOffset + strings.size());
+    header.recordsSize = records.size();
+    header.fileSize = header.recordsOffset + records.size();
+    return header;
+}
+
+void SnapshotWriter::fill(char* image, const SnapshotHeader& header) const {
+    std::memset(image + sizeof(header), 0, header.fileSize - sizeof(header));
+    if (!events.empty()) std::memcpy(image + header.eventsOffset, events.data(), events.size() * sizeof(EventRecord));
+    if (!strings.empty()) std::memcpy(image + header.stringsOffset, strings.data(), strings.size());
+    if (!records.empty()) std::memcpy(image + header.recordsOffset, records.data(), records.size());
+}
+
+void SnapshotWriter::write(const std::string& path) const {
+    SnapshotHeader header = layout();
+    std::vector<char> image(header.fileSize);
+    std::memcpy(image.data(), &header, sizeof(header));
+    fill(image.data(), header);
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(image.data(), image.size());
+        if (!out) throw std::runtime_error("Cannot write snapshot");
+    }
+    std::remove(path.c_str());
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) throw std::runtime_error("Cannot write snapshot");
+}
+
+std::unique_ptr<SharedSegment> SnapshotWriter::publish(const std::string& name) const {
+    SnapshotHeader header = layout();
+    auto segment = std::make_unique<SharedSegment>(name, header.fileSize);
+    fill(segment->data(), header);
+    // Everything else must be visible before the magic that marks the image complete
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(segment->data(), &header, sizeof(header));
+    return segment;
+}
+
+SnapshotImage::SnapshotImage(const std::string& path, const SnapshotSource& expected, bool sharedMemory) :
+    file(path, sharedMemory) {
+    if (file.size() < sizeof(SnapshotHeader)) throw std::runtime_error("Truncated snapshot");
+    std::memcpy(&header, file.data(), sizeof(SnapshotHeader));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || header.version != snapshotVersion)
+        throw std::runtime_error("Not a snapshot of this version");
+    // Shared-memory views may be rounded up to whole pages
+    if (sharedMemory ? header.fileSize > file.size() : header.fileSize != file.size())
+        throw std::runtime_error("Malformed snapshot");
+    // Sections in order first, so each size is checked against the space left and no sum can wrap
+    if (header.eventsOffset < sizeof(SnapshotHeader) || header.stringsOffset < header.eventsOffset ||
+        header.recordsOffset < header.stringsOffset || header.fileSize < header.recordsOffset ||
+        header.eventCount > (header.stringsOffset - header.eventsOffset) / sizeof(SnapshotWriter::EventRecord) ||
+        header.stringsSize > header.recordsOffset - header.stringsOffset ||
+        header.recordsSize > header.fileSize - header.recordsOffset)
+        throw std::runtime_error("Malformed snapshot");
+    if (!(header.source == expected)) throw std::runtime_error("Snapshot is stale");
+}
+
+std::string SnapshotImage::pooledString(uint32_t offset) const {
+    uint32_t size;
+    if (uint64_t(offset) + sizeof(size) > header.stringsSize) throw std::runtime_error("Malformed snapshot");
+    const char* entry = file.data() + header.stringsOffset + offset;
+    std::memcpy(&size, entry, sizeof(size));
+    if (uint64_t(offset) + sizeof(size) + size > header.stringsSize) throw std::runtime_error("Malformed snapshot");
+    return std::string(entry + sizeof(size), size);
+}
+
+CollisionEvent SnapshotImage::event(size_t index) const {
+    if (index >= header.eventCount) throw std::runtime_error("Snapshot event out of range");
+    SnapshotWriter::EventRecord record;
+    std::memcpy(&record, file.data() + header.eventsOffset + index * sizeof(record), sizeof(record));
+    CollisionEvent event;
+    event.eventId = record.eventId;
+    event.incomingParticles = pooledString(record.incoming);
+    event.outgoingParticles = pooledString(record.outgoing);
+    event.kineticEnergyIn = record.kineticEnergyIn;
+    event.restEnergyOut = record.restEnergyOut;
+    event.efficiency = record.efficiency;
+    return event;
+}
+
+std::vector<CollisionEvent> SnapshotImage::events(EnergyRange& range) const {
+    std::vector<CollisionEvent> result;
+    result.reserve(header.eventCount);
+    range = {0, 0};
+    for (size_t i = 0; i < header.eventCount; ++i) {
+        result.push_back(event(i));
+        float rest = result.back().restEnergyOut;
+        if (i == 0) range = {rest, rest};
+        range.minRestEnergy = std::min(range.minRestEnergy, rest);
+        range.maxRestEnergy = std::max(range.maxRestEnergy, rest);
+    }
+    return result;
+}
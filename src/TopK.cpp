@@ -0,0 +1,27 @@
+#include "TopK.h"
+#include <algorithm>
+
+namespace {
+bool moreEfficient(const CollisionEvent* a, const CollisionEvent* b) {
+    return a->efficiency > b->efficiency;
+}
+}
+
+void TopK::offer(const CollisionEvent* event) {
+    if (!admits(event->efficiency)) return;
+    if (heap.size() == k) {
+        std::pop_heap(heap.begin(), heap.end(), moreEfficient);
+        heap.back() = event;
+    } else {
+        heap.push_back(event);
+    }
+    std::push_heap(heap.begin(), heap.end(), moreEfficient);
+}
+
+QueryResult TopK::result() const {
+    std::vector<const CollisionEvent*> sorted = heap;
+    std::sort(sorted.begin(), sorted.end(), moreEfficient);
+    QueryResult result;
+    for (const CollisionEvent* event : sorted) result.add(event);
+    return result;
+}
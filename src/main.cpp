@@ -1,8 +1,22 @@
 #include "KDTree.h"
 #include "GridBucketing.h"
+#include "LearnedIndex.h"
+#include "CachedIndex.h"
+#include "ApproximateIndex.h"
+#include "QuantileSketch.h"
+#include "StaticIndex.h"
+#include "CompositionIndex.h"
+#include "SignatureIndex.h"
+#include "QueryExecutor.h"
+#include "QueryPlanner.h"
 #include "DataLoader.h"
+#include "Snapshot.h"
+#include "SharedIndex.h"
+#include "AllocationTracker.h"
+#include "ScanKernels.h"
 #include <pdcurses/curses.h>
 #include <fstream>
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <string>
@@ -53,8 +67,31 @@ int main() {
     };
     printMainMenu();
 
+    // Query output, shared by the range and top-k queries
+    auto saveResults = [](const QueryResult& results, const char* path) {
+        std::ofstream out(path);
+        out << "eventId,incomingParticles,outgoingParticles,kineticEnergyIn,restEnergyOut,efficiency\n";
+        for (const auto& event : results) {
+            out << event.eventId << ","
+                << "\"" << event.incomingParticles.c_str() << "\","
+                << "\"" << event.outgoingParticles.c_str() << "\","
+                << std::fixed << std::setprecision(4) << event.kineticEnergyIn << ","
+                << std::fixed << std::setprecision(4) << event.restEnergyOut << ","
+                << std::fixed << std::setprecision(6) << event.efficiency << "," << "\n";
+        }
+        out.close();
+    };
+
     std::unique_ptr<DataStructure> ds;
     std::vector<CollisionEvent> events;
+    CompositionIndex composition;  ///< particle-content bitmaps of the loaded events
+    SignatureIndex signatures;     ///< loaded events grouped by exact particle composition
+    QueryExecutor executor;        ///< worker pool; wide range queries are split across it
+    std::unique_ptr<CachedIndex> cache;  ///< recent range-query results of ds
+    std::unique_ptr<ApproximateIndex> approx;  ///< per-cell samples of the loaded events, built on first use
+    const std::string sharedIndexName = "/atlas_collision_index";
+    std::unique_ptr<SharedSegment> published;  ///< segment this session published, kept mapped while it runs
+    EnergyRange range = {0, 210};  ///< restEnergyOut span of the loaded events, sizes the grids
     int choice;
 
 	while (true) {
@@ -66,53 +103,147 @@ int main() {
             mvwprintw(menu_win, 1, 2, "Choose Data Structure:");
             mvwprintw(menu_win, 2, 2, "1. KDTree");
             mvwprintw(menu_win, 3, 2, "2. GridBucketing");
+            mvwprintw(menu_win, 4, 2, "3. LearnedIndex");
+            mvwprintw(menu_win, 5, 2, "4. GridBucketing (equi-depth)");
+            mvwprintw(menu_win, 6, 2, "5. GridBucketing (2-D, multiplicity)");
+            mvwprintw(menu_win, 7, 2, "6. StaticIndex (read-mostly, 16-key leaves)");
+            mvwprintw(menu_win, 8, 2, "7. QueryPlanner (all indexes, cost-based)");
+            mvwprintw(menu_win, 9, 2, "8. Shared index (attach, or load and publish)");
             wattron(menu_win, COLOR_PAIR(2));
-            mvwprintw(menu_win, 5, 2, "Enter choice (1 or 2): ");
+            mvwprintw(menu_win, 10, 2, "Enter choice (1-8): ");
             wattroff(menu_win, COLOR_PAIR(2));
             wrefresh(menu_win);
             int dsChoice = getch();
 
-            // Load data into structure
-            if (dsChoice == '1') {
-                ds = std::make_unique<KDTree>();
-            } else if (dsChoice == '2') {
-                ds = std::make_unique<GridBucketing>(0, 210);
-            } else {
+            if (dsChoice < '1' || dsChoice > '8') {
                 wattron(menu_win, COLOR_PAIR(3));
-                mvwprintw(menu_win, 7, 2, "Invalid choice. Press any key.");
+                mvwprintw(menu_win, 12, 2, "Invalid choice. Press any key.");
                 wattroff(menu_win, COLOR_PAIR(3));
                 wrefresh(menu_win);
                 getch();
                 printMainMenu();
                 continue;
             }
-            events = loadData("../data/collision_data.bin");
-
-            // Export all events to CSV for visualization
-            std::ofstream allEventsOut("../data/all_events.csv");
-            allEventsOut << "eventId,incomingParticles,outgoingParticles,kineticEnergyIn,restEnergyOut,efficiency\n";
-            for (const auto& e : events) {
-                allEventsOut << e.eventId << ","
-                             << "\"" << e.incomingParticles.c_str() << "\","
-                             << "\"" << e.outgoingParticles.c_str() << "\","
-                             << std::fixed << std::setprecision(6) << e.kineticEnergyIn << ","
-                             << std::fixed << std::setprecision(6) << e.restEnergyOut << ","
-                             << std::fixed << std::setprecision(6) << e.efficiency << "\n";
-            }
-            allEventsOut.close();
+            cache.reset();
+            approx.reset();
+            // KDTree and grid snapshots skip loading and building when the data file is unchanged
+            const std::string dataPath = "../data/collision_data.bin";
+            std::string snapshotPath;
+            if (dsChoice >= '1' && dsChoice <= '5' && dsChoice != '3')
+                snapshotPath = std::string("../data/index_") + static_cast<char>(dsChoice) + ".snapshot";
             auto start = std::chrono::high_resolution_clock::now();
-            if (dsChoice == '1') {
-                dynamic_cast<KDTree*>(ds.get())->buildBalanced(events);
-            } else {
-                for (const auto& event : events) {
-                    ds->insert(event);
+            SnapshotSource source;
+            std::unique_ptr<SnapshotImage> image;
+            if (!snapshotPath.empty()) {
+                try {
+                    source = SnapshotSource::of(dataPath);
+                    image = std::make_unique<SnapshotImage>(snapshotPath, source);
+                } catch (const std::runtime_error&) {
+                    // Missing, stale or damaged: rebuild from the data file and rewrite it below
+                }
+            }
+            // A shared index is attached if one of this data file is published; the first session publishes it
+            bool attached = false;
+            if (dsChoice == '8') {
+                ds.reset();
+                try {
+                    source = SnapshotSource::of(dataPath);
+                    ds = std::make_unique<SharedIndex>(sharedIndexName, source);
+                    attached = true;
+                } catch (const std::runtime_error&) {
+                    // Not published yet, or published from other data
+                }
+            }
+            if (attached) events.clear();
+            else events = image ? image->events(range) : loadData(dataPath, range);
+            composition.build(events);
+            signatures.build(events);
+
+            // Load data into structure; grids are sized to the range found while loading
+            auto makeIndex = [&]() {
+                if (dsChoice == '1') {
+                    ds = std::make_unique<KDTree>();
+                } else if (dsChoice == '2') {
+                    ds = std::make_unique<GridBucketing>(range.minRestEnergy, range.maxRestEnergy);
+                } else if (dsChoice == '3') {
+                    ds = std::make_unique<LearnedIndex>();
+                } else if (dsChoice == '4') {
+                    auto grid = std::make_unique<GridBucketing>(range.minRestEnergy, range.maxRestEnergy);
+                    if (!image) grid->adaptBoundaries(events);
+                    ds = std::move(grid);
+                } else if (dsChoice == '6') {
+                    ds = std::make_unique<StaticRangeIndex>();
+                } else if (dsChoice == '7') {
+                    ds = std::make_unique<QueryPlanner>(composition, signatures);
+                } else if (dsChoice == '8') {
+                    if (!attached) {
+                        published = SharedIndex::publish(sharedIndexName, events, source);
+                        ds = std::make_unique<SharedIndex>(sharedIndexName, source);
+                    }
+                } else {
+                    ds = std::make_unique<GridBucketing>(range.minRestEnergy, range.maxRestEnergy, 100,
+                                                         GridAxis::Multiplicity, 0, 20, 20);
                 }
+            };
+            makeIndex();
+            auto* tree = dynamic_cast<KDTree*>(ds.get());
+            auto* grid = dynamic_cast<GridBucketing*>(ds.get());
+            if (image) {
+                try {
+                    if (tree) tree->load_snapshot(*image);
+                    else grid->load_snapshot(*image);
+                } catch (const std::runtime_error&) {
+                    // Damaged past the checks made on opening: rebuild from the data file and rewrite it below
+                    image.reset();
+                    events = loadData(dataPath, range);
+                    composition.build(events);
+                    signatures.build(events);
+                    makeIndex();
+                    tree = dynamic_cast<KDTree*>(ds.get());
+                    grid = dynamic_cast<GridBucketing*>(ds.get());
+                }
+            }
+            if (!image && dsChoice != '8') {
+                // Builds may reorder what they are given, and the signature index holds row ids into events
+                std::vector<CollisionEvent> scratch = events;
+                ds->build(scratch);
             }
             auto end = std::chrono::high_resolution_clock::now();
+            if (!image && !snapshotPath.empty()) {
+                try {
+                    if (tree) tree->save_snapshot(snapshotPath, source);
+                    else grid->save_snapshot(snapshotPath, source);
+                } catch (const std::runtime_error&) {
+                    // A snapshot is only a shortcut; failing to write one is not an error
+                }
+            }
+
+            // Export all events to CSV for visualization; attached sessions hold no private copy to export
+            if (!attached) {
+                std::ofstream allEventsOut("../data/all_events.csv");
+                allEventsOut << "eventId,incomingParticles,outgoingParticles,kineticEnergyIn,restEnergyOut,efficiency\n";
+                for (const auto& e : events) {
+                    allEventsOut << e.eventId << ","
+                                 << "\"" << e.incomingParticles.c_str() << "\","
+                                 << "\"" << e.outgoingParticles.c_str() << "\","
+                                 << std::fixed << std::setprecision(6) << e.kineticEnergyIn << ","
+                                 << std::fixed << std::setprecision(6) << e.restEnergyOut << ","
+                                 << std::fixed << std::setprecision(6) << e.efficiency << "\n";
+            }
+            allEventsOut.close();
+            }
+            cache = std::make_unique<CachedIndex>(*ds, 32, &executor);
             long loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-            mvwprintw(menu_win, 7, 2, "Loaded %d events in %ld ms.", events.size(), loadTime);
-            mvwprintw(menu_win, 8, 2, "Exported to all_events.csv.");
-            mvwprintw(menu_win, 9, 2, "Press any key to continue.");
+            if (attached) {
+                mvwprintw(menu_win, 11, 2, "Attached to shared index of %zu events in %ld ms.",
+                          static_cast<SharedIndex*>(ds.get())->size(), loadTime);
+                mvwprintw(menu_win, 12, 2, "Composition/signature/sample queries need a private load.");
+            } else {
+                mvwprintw(menu_win, 11, 2, "Loaded %zu events in %ld ms%s.", events.size(), loadTime,
+                          image ? " from snapshot" : dsChoice == '8' ? " and published" : "");
+                mvwprintw(menu_win, 12, 2, "Exported to all_events.csv.");
+            }
+            mvwprintw(menu_win, 13, 2, "Press any key to continue.");
             wrefresh(menu_win);
             getch();
             printMainMenu();
@@ -132,11 +263,33 @@ int main() {
             mvwprintw(menu_win, 1, 2, "Query Events:");
             mvwprintw(menu_win, 2, 2, "1. Range Query");
             mvwprintw(menu_win, 3, 2, "2. Extremum Query");
+            mvwprintw(menu_win, 4, 2, "3. 2-D Range Query (rest energy x multiplicity)");
+            mvwprintw(menu_win, 5, 2, "4. Top-k Query");
+            mvwprintw(menu_win, 6, 2, "5. Aggregate Query (statistics + histogram)");
+            mvwprintw(menu_win, 7, 2, "6. Composition Query (range + particle cut)");
+            mvwprintw(menu_win, 8, 2, "7. Signature Query (exact composition)");
+            mvwprintw(menu_win, 9, 2, "8. Approximate Aggregate (sampled, 95%% CI)");
+            mvwprintw(menu_win, 10, 2, "9. Quantile Query (efficiency + rest energy deciles)");
             wattron(menu_win, COLOR_PAIR(2));
-            mvwprintw(menu_win, 5, 2, "Enter choice (1 or 2): ");
+            mvwprintw(menu_win, 11, 2, "Enter choice (1-9): ");
             wattroff(menu_win, COLOR_PAIR(2));
             wrefresh(menu_win);
             int subChoice = getch();
+            auto* planner = dynamic_cast<QueryPlanner*>(ds.get());
+            // Clear the option list so the chosen query's prompts start on a clean window
+            werase(menu_win);
+            box(menu_win, 0, 0);
+            mvwprintw(menu_win, 1, 2, "Query Events:");
+            if (events.empty() && subChoice >= '6' && subChoice <= '8') {
+                // An attached shared index holds no private events to cut, group or sample
+                wattron(menu_win, COLOR_PAIR(3));
+                mvwprintw(menu_win, 10, 2, "Load the events privately first! Press any key.");
+                wattroff(menu_win, COLOR_PAIR(3));
+                wrefresh(menu_win);
+                getch();
+                printMainMenu();
+                continue;
+            }
             if (subChoice == '1') {
                 float minRest, maxRest;
                 wattron(menu_win, COLOR_PAIR(2));
@@ -150,41 +303,336 @@ int main() {
                 noecho();
                 wattroff(menu_win, COLOR_PAIR(2));
                 auto start = std::chrono::high_resolution_clock::now();
-                auto results = ds->range_query(minRest, maxRest);
+                auto results = cache->range_query_view(minRest, maxRest);
                 auto end = std::chrono::high_resolution_clock::now();
-                mvwprintw(menu_win, 10, 2, "Found %d events in %ld us",
+                CacheStats stats = cache->stats();
+                if (planner) mvwprintw(menu_win, 9, 2, "Plan: %s", planner->explain(QueryKind::Range, minRest, maxRest));
+                mvwprintw(menu_win, 10, 2, "Found %zu events in %ld us",
                           results.size(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
-                mvwprintw(menu_win, 11, 2, "Results saved to range_query_results.csv");
-                mvwprintw(menu_win, 12, 2, "Press any key to continue.");
-                wrefresh(menu_win);
-                std::ofstream out("../data/range_query_results.csv");
-                out << "eventId,incomingParticles,outgoingParticles,kineticEnergyIn,restEnergyOut,efficiency\n";
-                for (const auto& event : results) {
-                    out << event.eventId << ","
-                        << "\"" << event.incomingParticles.c_str() << "\","
-                        << "\"" << event.outgoingParticles.c_str() << "\","
-                    	<< std::fixed << std::setprecision(4) << event.kineticEnergyIn << ","
-                    	<< std::fixed << std::setprecision(4) << event.restEnergyOut << ","
-                    	<< std::fixed << std::setprecision(6) << event.efficiency << "," << "\n";
-                }
-                out.close();
+                mvwprintw(menu_win, 11, 2, "Cache: %zu hits, %zu contained, %zu misses", stats.hits, stats.contained, stats.misses);
+                mvwprintw(menu_win, 12, 2, "Results saved to range_query_results.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                saveResults(results, "../data/range_query_results.csv");
                 getch();
                 printMainMenu();
             } else if (subChoice == '2') {
                 auto start = std::chrono::high_resolution_clock::now();
-                CollisionEvent maxEffEvent = ds->find_max_efficiency();
+                const CollisionEvent& maxEffEvent = ds->find_max_efficiency();
                 auto end = std::chrono::high_resolution_clock::now();
 				mvwprintw(menu_win, 7, 2, "Max efficiency: %.4f (Event %d)",
                           maxEffEvent.efficiency, maxEffEvent.eventId);
                 mvwprintw(menu_win, 8, 2, "Time: %ld us",
                           std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                if (planner) mvwprintw(menu_win, 9, 2, "Plan: %s", planner->explain(QueryKind::Extremum, 0, 0));
                 mvwprintw(menu_win, 10, 2, "Press any key to continue.");
                 wrefresh(menu_win);
                 getch();
                 printMainMenu();
+            } else if (subChoice == '3') {
+                auto* grid = dynamic_cast<GridBucketing*>(ds.get());
+                if (!grid) {
+                    wattron(menu_win, COLOR_PAIR(3));
+                    mvwprintw(menu_win, 7, 2, "Needs a GridBucketing. Press any key.");
+                    wattroff(menu_win, COLOR_PAIR(3));
+                    wrefresh(menu_win);
+                    getch();
+                    printMainMenu();
+                    continue;
+                }
+                float minRest, maxRest, minCount, maxCount;
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 7, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 8, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                mvwprintw(menu_win, 9, 2, "Enter min particle count: ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minCount);
+                mvwprintw(menu_win, 10, 2, "Enter max particle count: ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxCount);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                auto start = std::chrono::high_resolution_clock::now();
+                auto results = grid->range_query_2d(minRest, maxRest, minCount, maxCount);
+                auto end = std::chrono::high_resolution_clock::now();
+                mvwprintw(menu_win, 11, 2, "Found %zu events in %ld us",
+                          results.size(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                mvwprintw(menu_win, 12, 2, "Results saved to range_query_results.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                saveResults(results, "../data/range_query_results.csv");
+                getch();
+                printMainMenu();
+            } else if (subChoice == '4') {
+                int k;
+                float minRest, maxRest;
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 7, 2, "Enter k: ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%d", &k);
+                mvwprintw(menu_win, 8, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 9, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                auto start = std::chrono::high_resolution_clock::now();
+                auto results = ds->top_k_in_range(k > 0 ? k : 0, minRest, maxRest);
+                auto end = std::chrono::high_resolution_clock::now();
+                if (planner) mvwprintw(menu_win, 10, 2, "Plan: %s", planner->explain(QueryKind::TopK, minRest, maxRest));
+                mvwprintw(menu_win, 11, 2, "Found %zu events in %ld us",
+                          results.size(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                mvwprintw(menu_win, 12, 2, "Results saved to top_k_results.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                saveResults(results, "../data/top_k_results.csv");
+                getch();
+                printMainMenu();
+            } else if (subChoice == '5') {
+                float minRest, maxRest;
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 8, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 9, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                const size_t bins = 20;
+                auto start = std::chrono::high_resolution_clock::now();
+                Aggregate stats = ds->aggregate(minRest, maxRest);
+                std::vector<size_t> counts = ds->histogram(minRest, maxRest, bins);
+                auto end = std::chrono::high_resolution_clock::now();
+                mvwprintw(menu_win, 10, 2, "%zu events, mean efficiency %.6f (%ld us)", stats.count,
+                          stats.meanEfficiency(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                if (stats.count) {
+                    mvwprintw(menu_win, 11, 2, "Efficiency %.6f - %.6f, mean rest %.2f GeV",
+                              stats.minEfficiency, stats.maxEfficiency, stats.meanRestEnergy());
+                }
+                std::ofstream out("../data/histogram_results.csv");
+                out << "binMinRestEnergy,binMaxRestEnergy,count\n";
+                float width = (maxRest - minRest) / bins;
+                for (size_t b = 0; b < bins; ++b) {
+                    out << std::fixed << std::setprecision(4) << minRest + b * width << ","
+                        << std::fixed << std::setprecision(4) << minRest + (b + 1) * width << "," << counts[b] << "\n";
+                }
+                out.close();
+                mvwprintw(menu_win, 12, 2, "Histogram saved to histogram_results.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                getch();
+                printMainMenu();
+            } else if (subChoice == '6') {
+                float minRest, maxRest;
+                char cutText[128] = "";
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 7, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 8, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                mvwprintw(menu_win, 9, 2, "Cut (e.g. muon>=2,electron=0): ");
+                wrefresh(menu_win);
+                wgetnstr(menu_win, cutText, sizeof(cutText) - 1);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                CompositionCut cut;
+                try {
+                    cut = parseCompositionCut(cutText);
+                } catch (const std::runtime_error& e) {
+                    wattron(menu_win, COLOR_PAIR(3));
+                    mvwprintw(menu_win, 11, 2, "%.50s", e.what());
+                    mvwprintw(menu_win, 12, 2, "Press any key.");
+                    wattroff(menu_win, COLOR_PAIR(3));
+                    wrefresh(menu_win);
+                    getch();
+                    printMainMenu();
+                    continue;
+                }
+                auto start = std::chrono::high_resolution_clock::now();
+                auto results = planner ? planner->composition_query(cut, minRest, maxRest)
+                                       : composition.select(cut).filter(ds->range_query_view(minRest, maxRest));
+                auto end = std::chrono::high_resolution_clock::now();
+                if (planner) mvwprintw(menu_win, 10, 2, "Plan: %.48s", planner->explain_composition(cut, minRest, maxRest).c_str());
+                mvwprintw(menu_win, 11, 2, "Found %zu events in %ld us",
+                          results.size(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                mvwprintw(menu_win, 12, 2, "Results saved to range_query_results.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                saveResults(results, "../data/range_query_results.csv");
+                getch();
+                printMainMenu();
+            } else if (subChoice == '7') {
+                char signatureText[128] = "";
+                float minRest, maxRest;
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 7, 2, "Signature (e.g. jet,jet,photon): ");
+                wrefresh(menu_win);
+                wgetnstr(menu_win, signatureText, sizeof(signatureText) - 1);
+                mvwprintw(menu_win, 8, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 9, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                auto start = std::chrono::high_resolution_clock::now();
+                auto results = signatures.range_query(countParticles(signatureText), minRest, maxRest);
+                auto end = std::chrono::high_resolution_clock::now();
+                saveResults(results, "../data/range_query_results.csv");
+
+                // Composition-by-efficiency summary: a group-by over signatures, largest first
+                std::vector<const Signature*> bySize;
+                for (const auto& group : signatures.signatures()) bySize.push_back(&group);
+                std::sort(bySize.begin(), bySize.end(),
+                          [](const Signature* a, const Signature* b) { return a->count > b->count; });
+                std::ofstream out("../data/signature_summary.csv");
+                out << "signature,count,meanEfficiency,maxEfficiency,meanRestEnergyOut\n";
+                for (const Signature* group : bySize) {
+                    out << "\"" << signatureName(group->counts) << "\"," << group->count << ","
+                        << std::fixed << std::setprecision(6) << group->summary.meanEfficiency() << ","
+                        << std::fixed << std::setprecision(6) << group->summary.maxEfficiency << ","
+                        << std::fixed << std::setprecision(4) << group->summary.meanRestEnergy() << "\n";
+                }
+                out.close();
+                mvwprintw(menu_win, 11, 2, "Found %zu events in %ld us",
+                          results.size(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                mvwprintw(menu_win, 12, 2, "Saved range_query_results.csv, signature_summary.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                getch();
+                printMainMenu();
+            } else if (subChoice == '8') {
+                float minRest, maxRest, targetPercent;
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 7, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 8, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                mvwprintw(menu_win, 9, 2, "Target error (%%, e.g. 1): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &targetPercent);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                if (!approx) {
+                    approx = std::make_unique<ApproximateIndex>();
+                    // Strata are grid cells: a loaded grid serves as is, any other index gets a grid of the events
+                    if (auto* grid = dynamic_cast<GridBucketing*>(ds.get())) {
+                        approx->build(*grid);
+                    } else {
+                        GridBucketing strata(range.minRestEnergy, range.maxRestEnergy);
+                        strata.insertBulk(events);
+                        approx->build(strata);
+                    }
+                }
+
+                // Refine until the target is met, the samples run out or a key is pressed
+                nodelay(stdscr, true);
+                ApproximateAggregate estimate;
+                size_t perCell = 32;
+                for (;; perCell *= 2) {
+                    estimate = approx->aggregate(minRest, maxRest, perCell);
+                    mvwprintw(menu_win, 10, 2, "Count %.0f +/- %.0f (%zu rows sampled)      ",
+                              estimate.count.value, estimate.count.halfWidth, estimate.sampled);
+                    mvwprintw(menu_win, 11, 2, "Mean efficiency %.6f +/- %.6f      ",
+                              estimate.meanEfficiency.value, estimate.meanEfficiency.halfWidth);
+                    wrefresh(menu_win);
+                    if (ApproximateIndex::converged(estimate, targetPercent / 100) ||
+                        perCell >= approx->samples_per_cell() || getch() != ERR)
+                        break;
+                }
+                nodelay(stdscr, false);
+
+                const size_t bins = 20;
+                std::vector<Estimate> counts = approx->histogram(minRest, maxRest, bins, perCell);
+                std::ofstream out("../data/approximate_histogram.csv");
+                out << "binMinRestEnergy,binMaxRestEnergy,count,halfWidth95\n";
+                float width = (maxRest - minRest) / bins;
+                for (size_t b = 0; b < bins; ++b) {
+                    out << std::fixed << std::setprecision(4) << minRest + b * width << ","
+                        << std::fixed << std::setprecision(4) << minRest + (b + 1) * width << ","
+                        << std::fixed << std::setprecision(1) << counts[b].value << "," << counts[b].halfWidth << "\n";
+                }
+                out.close();
+                mvwprintw(menu_win, 12, 2, "Histogram saved to approximate_histogram.csv");
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                getch();
+                printMainMenu();
+            } else if (subChoice == '9') {
+                float minRest, maxRest;
+                wattron(menu_win, COLOR_PAIR(2));
+                echo();
+                mvwprintw(menu_win, 8, 2, "Enter min rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &minRest);
+                mvwprintw(menu_win, 9, 2, "Enter max rest energy (GeV): ");
+                wrefresh(menu_win);
+                wscanw(menu_win, "%f", &maxRest);
+                noecho();
+                wattroff(menu_win, COLOR_PAIR(2));
+                // Only grids keep sketches (per cell, merged here); other structures sketch the window's events
+                auto start = std::chrono::high_resolution_clock::now();
+                QuantileSketch efficiencies, restEnergies;
+                if (auto* grid = dynamic_cast<GridBucketing*>(ds.get())) {
+                    efficiencies = grid->efficiency_quantiles(minRest, maxRest);
+                    restEnergies = grid->rest_energy_quantiles(minRest, maxRest);
+                } else {
+                    for (const auto& event : ds->range_query_view(minRest, maxRest)) {
+                        efficiencies.add(event.efficiency);
+                        restEnergies.add(event.restEnergyOut);
+                    }
+                }
+                std::vector<double> deciles = {0, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1};
+                std::vector<float> efficiencyDeciles, restDeciles;
+                if (efficiencies.count()) {
+                    efficiencyDeciles = efficiencies.quantiles(deciles);
+                    restDeciles = restEnergies.quantiles(deciles);
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                mvwprintw(menu_win, 10, 2, "%zu events (%ld us)", efficiencies.count(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+                if (efficiencies.count()) {
+                    mvwprintw(menu_win, 11, 2, "Median efficiency %.6f, rest %.2f GeV",
+                              efficiencyDeciles[5], restDeciles[5]);
+                    std::ofstream out("../data/quantile_results.csv");
+                    out << "quantile,efficiency,restEnergyOut\n";
+                    for (size_t q = 0; q < deciles.size(); ++q) {
+                        out << std::fixed << std::setprecision(1) << deciles[q] << ","
+                            << std::fixed << std::setprecision(6) << efficiencyDeciles[q] << ","
+                            << std::fixed << std::setprecision(4) << restDeciles[q] << "\n";
+                    }
+                    out.close();
+                    // Binary sketches can be merged with those of other files or runs
+                    std::ofstream sketches("../data/quantile_sketches.bin", std::ios::binary);
+                    efficiencies.write(sketches);
+                    restEnergies.write(sketches);
+                    mvwprintw(menu_win, 12, 2, "Deciles saved to quantile_results.csv");
+                }
+                mvwprintw(menu_win, 13, 2, "Press any key to continue.");
+                wrefresh(menu_win);
+                getch();
+                printMainMenu();
             } else {
                 wattron(menu_win, COLOR_PAIR(3));
-                mvwprintw(menu_win, 7, 2, "Invalid choice. Press any key.");
+                mvwprintw(menu_win, 8, 2, "Invalid choice. Press any key.");
                 wattroff(menu_win, COLOR_PAIR(3));
                 wrefresh(menu_win);
                 getch();
@@ -200,40 +648,58 @@ int main() {
                 printMainMenu();
                 continue;
             }
+            if (events.empty()) {
+                // An attached shared index holds no private events to rebuild the structures from
+                wattron(menu_win, COLOR_PAIR(3));
+                mvwprintw(menu_win, 10, 2, "Load the events privately first! Press any key.");
+                wattroff(menu_win, COLOR_PAIR(3));
+                wrefresh(menu_win);
+                getch();
+                printMainMenu();
+                continue;
+            }
             werase(menu_win);
             box(menu_win, 0, 0);
             mvwprintw(menu_win, 1, 2, "Generating performance report...");
             wrefresh(menu_win);
+            cache.reset();
             std::ofstream out("../data/performance_results.csv");
-            out << "DataStructure,AvgInsertionTime(ms),StdDevInsertionTime(ms),AvgRangeQueryTime(us),StdDevRangeQueryTime(us),AvgExtremumQueryTime(us),StdDevExtremumQueryTime(us),Memory(bytes)\n";
-            for (int i = 1; i <= 2; ++i) {
-                std::vector<long> insertTimes, rangeTimes, extremumTimes;
+            out << "DataStructure,AvgInsertionTime(ms),StdDevInsertionTime(ms),AvgRangeQueryTime(us),StdDevRangeQueryTime(us),AvgBatchRangeQueryTime(us),AvgPooledRangeQueryTime(us),AvgExtremumQueryTime(us),StdDevExtremumQueryTime(us),Memory(bytes),NodeMemory(bytes),PayloadMemory(bytes),StringMemory(bytes),SideMemory(bytes),MeasuredHeap(bytes)\n";
+            // Builds may reorder their input; events keeps the order the signature index refers to
+            std::vector<CollisionEvent> scratch = events;
+            for (int i = 1; i <= 5; ++i) {
+                std::vector<long> insertTimes, rangeTimes, batchTimes, pooledTimes, extremumTimes;
                 const int numRuns = 100;
+                // Heap growth across creating and building the index, from the last run
+                size_t measuredHeap = 0;
                 for (int run = 0; run < numRuns; ++run) {
+                    ds.reset();
+                    size_t heapBefore = AllocationTracker::live_bytes();
                     if (i == 1) {
                         ds = std::make_unique<KDTree>();
+                    } else if (i == 2 || i == 4) {
+                        auto grid = std::make_unique<GridBucketing>(range.minRestEnergy, range.maxRestEnergy);
+                        if (i == 4) grid->adaptBoundaries(events);
+                        ds = std::move(grid);
+                    } else if (i == 3) {
+                        ds = std::make_unique<LearnedIndex>();
                     } else {
-                        ds = std::make_unique<GridBucketing>(0, 210);
+                        ds = std::make_unique<StaticRangeIndex>();
                     }
 
                     // Insertions
                     auto start = std::chrono::high_resolution_clock::now();
-                    if (i == 1) {
-                        dynamic_cast<KDTree*>(ds.get())->buildBalanced(events);
-                    } else {
-                        for (const auto& event : events) {
-                            ds->insert(event);
-                        }
-                    }
+                    ds->build(scratch);
                     auto end = std::chrono::high_resolution_clock::now();
                     insertTimes.push_back(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+                    measuredHeap = AllocationTracker::live_bytes() - heapBefore;
 
                     // Queries
                     long rangeTime = 0, extremumTime = 0;
                     for (int j = 0; j < 10; ++j) {
                         // Range
                         start = std::chrono::high_resolution_clock::now();
-                        ds->range_query(100 + j * 10, 150 + j * 10);
+                        ds->range_query_view(100 + j * 10, 150 + j * 10);
                         end = std::chrono::high_resolution_clock::now();
                         rangeTime += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
 
@@ -244,12 +710,28 @@ int main() {
                         extremumTime += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
                     }
                     rangeTimes.push_back(rangeTime / 10);
+
+                    // The same ten windows as one batch, reported per window
+                    std::vector<RangeQuery> windows;
+                    for (int j = 0; j < 10; ++j) windows.push_back({100.0f + j * 10, 150.0f + j * 10});
+                    start = std::chrono::high_resolution_clock::now();
+                    ds->range_query_batch(windows);
+                    end = std::chrono::high_resolution_clock::now();
+                    batchTimes.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10);
+
+                    // The same windows as independent queries spread over the worker pool
+                    start = std::chrono::high_resolution_clock::now();
+                    executor.range_query_all(*ds, windows);
+                    end = std::chrono::high_resolution_clock::now();
+                    pooledTimes.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 10);
                     extremumTimes.push_back(extremumTime / 10);
                 }
 
                 // Calculate averages
                 double avgInsert = std::accumulate(insertTimes.begin(), insertTimes.end(), 0.0) / numRuns;
                 double avgRange = std::accumulate(rangeTimes.begin(), rangeTimes.end(), 0.0) / numRuns;
+                double avgBatch = std::accumulate(batchTimes.begin(), batchTimes.end(), 0.0) / numRuns;
+                double avgPooled = std::accumulate(pooledTimes.begin(), pooledTimes.end(), 0.0) / numRuns;
                 double avgExtremum = std::accumulate(extremumTimes.begin(), extremumTimes.end(), 0.0) / numRuns;
 
                 // Calculate standard deviations
@@ -263,26 +745,33 @@ int main() {
                 stdDevRange = std::sqrt(stdDevRange / (numRuns - 1));
                 stdDevExtremum = std::sqrt(stdDevExtremum / (numRuns - 1));
 
-                // Calculate memory usage
-                size_t memory = 100000 * sizeof(CollisionEvent);
-                if (i == 1) {
-                    memory += 10000 * sizeof(Node);
-                } else {
-                    memory += 100 * sizeof(Cell);
-                }
+                // Memory as the index accounts for it; the measured heap growth cross-checks the total
+                MemoryUsage memory = ds->memory_usage();
 
                 // Output to CSV file
-                out << (i == 1 ? "KDTree" : "GridBucketing") << ","
+                const char* names[] = {"KDTree", "GridBucketing", "LearnedIndex", "GridBucketingEquiDepth", "StaticIndex"};
+                out << names[i - 1] << ","
                     << std::fixed << std::setprecision(2) << avgInsert << ","
                     << std::fixed << std::setprecision(2) << stdDevInsert << ","
                     << std::fixed << std::setprecision(2) << avgRange << ","
                     << std::fixed << std::setprecision(2) << stdDevRange << ","
+                    << std::fixed << std::setprecision(2) << avgBatch << ","
+                    << std::fixed << std::setprecision(2) << avgPooled << ","
                     << std::fixed << std::setprecision(2) << avgExtremum << ","
                     << std::fixed << std::setprecision(2) << stdDevExtremum << ","
-                    << memory << "\n";
+                    << memory.total() << ","
+                    << memory.nodes << ","
+                    << memory.payload << ","
+                    << memory.strings << ","
+                    << memory.heaps << ",";
+                // Left empty unless built with TRACK_ALLOCATIONS
+                if (AllocationTracker::enabled()) out << measuredHeap;
+                out << "\n";
             }
             out.close();
+            cache = std::make_unique<CachedIndex>(*ds, 32, &executor);
             mvwprintw(menu_win, 3, 2, "Report saved to performance_results.csv");
+            mvwprintw(menu_win, 4, 2, "Range scans ran on the %s kernel", scanKernelName());
             mvwprintw(menu_win, 5, 2, "Press any key to continue.");
             wrefresh(menu_win);
             getch();
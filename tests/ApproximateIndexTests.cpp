@@ -0,0 +1,83 @@
+#include "ApproximateIndex.h"
+#include "TestSupport.h"
+#include <cmath>
+
+namespace {
+bool covers(const Estimate& estimate, double truth) {
+    return std::fabs(estimate.value - truth) <= estimate.halfWidth + 1e-9 * std::max(1.0, std::fabs(truth));
+}
+}
+
+/// 95% intervals against the true count and mean, and exact answers where the samples cover their cells.
+void testApproximateIndex() {
+    std::mt19937 rng(44);
+    std::vector<CollisionEvent> events = randomEvents(rng, 50000);
+    Reference reference(events);
+    GridBucketing grid(0.0f, 210.0f, 30);
+    grid.insertBulk(events);
+    ApproximateIndex approx(1024, 7);
+    approx.build(grid);
+
+    // Windows cutting through cells, each estimated from independent samples; about one interval in twenty misses
+    std::uniform_real_distribution<float> key(0.0f, 200.0f), width(1.0f, 60.0f);
+    std::vector<RangeQuery> cutting;
+    for (int q = 0; q < 50; ++q) {
+        float lo = key(rng);
+        cutting.push_back({lo, lo + width(rng)});
+    }
+    int estimates = 0, countCovered = 0, meanCovered = 0;
+    for (unsigned int seed = 1; seed <= 20; ++seed) {
+        ApproximateIndex sampled(1024, seed);
+        sampled.build(grid);
+        for (const RangeQuery& w : cutting) {
+            Aggregate truth = reference.aggregate(w.minRestEnergy, w.maxRestEnergy);
+            if (truth.count == 0) continue;
+            ApproximateAggregate estimate = sampled.aggregate(w.minRestEnergy, w.maxRestEnergy, 64);
+            ++estimates;
+            countCovered += covers(estimate.count, truth.count);
+            meanCovered += covers(estimate.meanEfficiency, truth.meanEfficiency());
+            check(estimate.sampled <= 64 * grid.cellCount(), "ApproximateIndex read more than perCell rows per cell");
+        }
+    }
+    check(countCovered >= estimates * 0.92, "ApproximateIndex count intervals covered " +
+                                                std::to_string(countCovered) + " of " + std::to_string(estimates));
+    check(meanCovered >= estimates * 0.92, "ApproximateIndex mean intervals covered " +
+                                               std::to_string(meanCovered) + " of " + std::to_string(estimates));
+
+    // Refinement meets its target or uses every sample
+    for (int q = 0; q < 20; ++q) {
+        float lo = key(rng), hi = lo + width(rng);
+        ApproximateAggregate estimate = approx.aggregate_to(lo, hi, 0.05);
+        check(ApproximateIndex::converged(estimate, 0.05) ||
+                  estimate.sampled == approx.aggregate(lo, hi, approx.samples_per_cell()).sampled,
+              "ApproximateIndex refinement stopped early");
+    }
+
+    // Windows over whole cells come from the exact cell aggregates
+    ApproximateAggregate everything = approx.aggregate(-infinity, infinity, 64);
+    check(everything.count.value == events.size() && everything.count.halfWidth == 0 && everything.sampled == 0,
+          "ApproximateIndex window over every cell");
+    check(approx.aggregate(50, 40, 64).count.value == 0, "ApproximateIndex inverted window");
+
+    // Samples as large as their cells make every window exact
+    ApproximateIndex complete(events.size());
+    complete.build(grid);
+    for (int q = 0; q < 50; ++q) {
+        float lo = key(rng), hi = lo + width(rng);
+        ApproximateAggregate estimate = complete.aggregate(lo, hi, events.size());
+        Aggregate truth = reference.aggregate(lo, hi);
+        check(estimate.count.value == truth.count && estimate.count.halfWidth == 0,
+              "ApproximateIndex with complete samples, window " + std::to_string(q));
+    }
+    std::vector<Estimate> bins = complete.histogram(20.0f, 120.0f, 10, events.size());
+    for (size_t b = 0; b < bins.size(); ++b) {
+        float lo = 20.0f + b * 10.0f, hi = b + 1 == bins.size() ? 120.0f : std::nextafter(lo + 10.0f, 0.0f);
+        check(bins[b].value == reference.range(lo, hi).size(), "ApproximateIndex histogram bin " + std::to_string(b));
+    }
+
+    // An empty grid samples to nothing rather than failing
+    GridBucketing empty(0.0f, 210.0f, 30);
+    ApproximateIndex none;
+    none.build(empty);
+    check(none.aggregate(-infinity, infinity, 64).count.value == 0, "ApproximateIndex over an empty grid");
+}
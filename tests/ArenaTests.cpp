@@ -0,0 +1,101 @@
+#include "Arena.h"
+#include "TestSupport.h"
+#include <cstdint>
+#include <cstring>
+
+namespace {
+struct Chunk {
+    unsigned char* start;
+    size_t bytes;
+    unsigned char fill;
+};
+
+bool aligned(const void* chunk) {
+    return reinterpret_cast<std::uintptr_t>(chunk) % alignof(std::max_align_t) == 0;
+}
+
+/// Every live chunk still holds the byte it was filled with, so none overlaps another.
+bool intact(const std::vector<Chunk>& live) {
+    for (const Chunk& chunk : live) {
+        for (size_t i = 0; i < chunk.bytes; ++i) {
+            if (chunk.start[i] != chunk.fill) return false;
+        }
+    }
+    return true;
+}
+}
+
+/// Alignment, disjoint chunks under random churn, free-list reuse and reset.
+void testArena() {
+    // Freed chunks are handed back to requests of the same size, and to smaller ones they fit
+    for (size_t bytes : {1, 16, 48, 100, 4096, 5000}) {
+        std::string name = "Arena reuse of " + std::to_string(bytes) + " bytes";
+        Arena arena(1024);
+        void* first = arena.allocate(bytes);
+        void* second = arena.allocate(bytes);
+        arena.deallocate(first, bytes);
+        check(arena.allocate(bytes) == first, name);
+        arena.deallocate(first, bytes);
+        void* smaller = arena.allocate(bytes / 2);
+        check(smaller == first, name + " for a smaller request");
+        // The rest of the chunk is not lost with the smaller request
+        arena.deallocate(smaller, bytes / 2);
+        arena.deallocate(second, bytes);
+        check(arena.allocated() == 0, name + " allocated after freeing everything");
+    }
+
+    // The latest chunk of the current block is returned by moving the cursor back
+    {
+        Arena arena;
+        void* chunk = arena.allocate(64);
+        arena.deallocate(chunk, 64);
+        check(arena.allocate(64) == chunk, "Arena reuse of the latest chunk");
+    }
+
+    // Random sizes and frees: every chunk aligned and disjoint from the others
+    std::mt19937 rng(48);
+    Arena arena(4096);
+    std::vector<Chunk> live;
+    bool allAligned = true;
+    for (int op = 0; op < 20000; ++op) {
+        if (!live.empty() && rng() % 5 < 2) {
+            size_t i = rng() % live.size();
+            arena.deallocate(live[i].start, live[i].bytes);
+            live[i] = live.back();
+            live.pop_back();
+            continue;
+        }
+        size_t bytes = 1 + (rng() % 8 == 0 ? rng() % 20000 : rng() % 200);
+        Chunk chunk{static_cast<unsigned char*>(arena.allocate(bytes)), bytes, static_cast<unsigned char>(op)};
+        allAligned = allAligned && aligned(chunk.start);
+        std::memset(chunk.start, chunk.fill, bytes);
+        live.push_back(chunk);
+        if (op % 1000 == 999) check(intact(live), "Arena chunks overlap after " + std::to_string(op) + " operations");
+    }
+    check(allAligned, "Arena chunk not aligned for every fundamental type");
+    check(intact(live), "Arena chunks overlap");
+
+    // Rebuilding a grown vector reuses the buffers freed by the last build
+    Arena vectors;
+    size_t heldAfterFirst = 0;
+    for (int round = 0; round < 5; ++round) {
+        ArenaVector<double> values{ArenaAllocator<double>(&vectors)};
+        ArenaVector<int> ids{ArenaAllocator<int>(&vectors)};
+        for (int i = 0; i < 50000; ++i) {
+            values.push_back(i);
+            ids.push_back(i);
+        }
+        if (round == 0) heldAfterFirst = vectors.reserved();
+    }
+    check(vectors.reserved() == heldAfterFirst, "Arena grew while rebuilding vectors of the same size");
+    check(vectors.allocated() == 0, "Arena allocated after the vectors were destroyed");
+
+    // reset() keeps the largest block and hands it out again from the start
+    arena.reset();
+    check(arena.allocated() == 0, "Arena allocated after reset");
+    size_t held = arena.reserved();
+    void* chunk = arena.allocate(16000);
+    check(aligned(chunk) && arena.reserved() == held, "Arena allocation after reset took a new block");
+    int* value = arena.make<int>(42);
+    check(*value == 42 && aligned(value), "Arena make");
+}
@@ -0,0 +1,43 @@
+#include "GridBucketing.h"
+#include "KDTree.h"
+#include "LearnedIndex.h"
+#include "StaticIndex.h"
+#include "TestSupport.h"
+#include <memory>
+
+/// range_query_batch() must answer each window exactly as range_query_view() does, in input order.
+void testBatches() {
+    std::vector<std::pair<std::string, std::unique_ptr<DataStructure>>> indexes;
+    indexes.emplace_back("KDTree", std::make_unique<KDTree>());
+    indexes.emplace_back("GridBucketing", std::make_unique<GridBucketing>(0.0f, 210.0f, 50));
+    indexes.emplace_back("LearnedIndex", std::make_unique<LearnedIndex>(16));
+    indexes.emplace_back("StaticIndex", std::make_unique<StaticRangeIndex>());
+    for (auto& entry : indexes) {
+        const std::string& name = entry.first;
+        DataStructure& index = *entry.second;
+        std::mt19937 rng(3);
+        std::vector<CollisionEvent> events = randomEvents(rng, 5000);
+        Reference reference(events);
+        index.build(events);
+        // Erased events must be skipped by the shared traversal too
+        for (int i = 0; i < 100; ++i) {
+            int eventId = static_cast<int>(rng() % 5000);
+            index.erase(eventId);
+            reference.events.erase(eventId);
+        }
+
+        std::vector<RangeQuery> queries;
+        for (int q = 0; q < 64; ++q) queries.push_back(randomWindow(rng));
+        // Repeated and nested windows share subtrees in the batched paths
+        queries.push_back(queries[0]);
+        queries.push_back({queries[1].minRestEnergy, queries[1].minRestEnergy + 1});
+        std::vector<QueryResult> batch = index.range_query_batch(queries);
+        check(batch.size() == queries.size(), name + " batch size");
+        for (size_t q = 0; q < queries.size() && q < batch.size(); ++q) {
+            float lo = queries[q].minRestEnergy, hi = queries[q].maxRestEnergy;
+            check(ids(batch[q]) == ids(index.range_query_view(lo, hi)) && ids(batch[q]) == reference.range(lo, hi),
+                  name + " batch window " + std::to_string(q));
+        }
+        check(index.range_query_batch({}).empty(), name + " empty batch");
+    }
+}
@@ -0,0 +1,85 @@
+#include "Bitmap.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+using IdSet = std::set<uint32_t>;
+
+/// Count ids from a few 65536-id containers, spread sparsely or packed densely into a narrow band.
+IdSet randomIds(std::mt19937& rng, size_t count, bool dense) {
+    IdSet ids;
+    uint32_t high = static_cast<uint32_t>(rng() % 3) << 16;
+    while (ids.size() < count) {
+        uint32_t value = dense ? high + rng() % 6000 : static_cast<uint32_t>(rng() % 4) << 16 | (rng() & 0xFFFF);
+        ids.insert(value);
+    }
+    // The extremes of the id space and of a container
+    if (rng() % 2) ids.insert({0u, 0xFFFFu, 0x10000u, 0xFFFFFFFFu});
+    return ids;
+}
+
+Bitmap bitmapOf(const IdSet& ids) {
+    Bitmap bitmap;
+    for (uint32_t id : ids) bitmap.add(id);
+    return bitmap;
+}
+
+bool sameSet(const Bitmap& bitmap, const IdSet& ids) {
+    std::vector<uint32_t> values = bitmap.values();
+    return bitmap.cardinality() == ids.size() && bitmap.empty() == ids.empty() &&
+           std::equal(values.begin(), values.end(), ids.begin(), ids.end());
+}
+}
+
+/// Set operations against std::set, on either side of the array/bitset switch, and composition cuts by brute force.
+void testBitmaps() {
+    std::mt19937 rng(37);
+    // Sizes around the 4096-value container limit, so results cross it in both directions
+    const size_t sizes[] = {0, 1, 100, 4095, 4096, 4097, 5000};
+    for (size_t a : sizes) {
+        for (size_t b : sizes) {
+            IdSet left = randomIds(rng, a, a >= 4095), right = randomIds(rng, b, rng() % 2);
+            std::string what = "Bitmap " + std::to_string(a) + " with " + std::to_string(b);
+            Bitmap x = bitmapOf(left), y = bitmapOf(right);
+            check(sameSet(x, left), what + " add/values");
+            IdSet both, either, only;
+            std::set_intersection(left.begin(), left.end(), right.begin(), right.end(), std::inserter(both, both.end()));
+            std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::inserter(either, either.end()));
+            std::set_difference(left.begin(), left.end(), right.begin(), right.end(), std::inserter(only, only.end()));
+            check(sameSet(x & y, both), what + " AND");
+            check(sameSet(x | y, either), what + " OR");
+            check(sameSet(x.andNot(y), only), what + " AND-NOT");
+            // Results that shrank back under the limit must still combine correctly
+            check(sameSet((x.andNot(y) | (x & y)), left), what + " AND-NOT rejoined with AND");
+            for (int probe = 0; probe < 50; ++probe) {
+                uint32_t id = probe % 2 && !left.empty() ? *std::next(left.begin(), rng() % left.size()) : rng() % 0x40000;
+                check(x.contains(id) == (left.count(id) == 1), what + " contains " + std::to_string(id));
+            }
+        }
+    }
+
+    // Composition cuts select exactly the events a brute-force match does, and filter keeps result order
+    std::vector<CollisionEvent> events = randomEvents(rng, 20000);
+    for (CollisionEvent& event : events) event.outgoingParticles = randomParticles(rng);
+    CompositionIndex composition;
+    composition.build(events);
+    QueryResult all;
+    all.add(events.data(), events.size());
+    for (int q = 0; q < 60; ++q) {
+        CompositionCut cut = randomCut(rng);
+        IdSet expected;
+        std::vector<int> inOrder;
+        for (const CollisionEvent& event : events) {
+            if (!cut.matches(countParticles(event.outgoingParticles))) continue;
+            expected.insert(event.eventId);
+            inOrder.push_back(event.eventId);
+        }
+        Bitmap selected = composition.select(cut);
+        check(sameSet(selected, expected), "CompositionIndex cut " + std::to_string(q));
+        check(selected.filter(all).eventIds() == inOrder, "Bitmap filter order, cut " + std::to_string(q));
+    }
+    IdSet everyId;
+    for (const CollisionEvent& event : events) everyId.insert(event.eventId);
+    check(sameSet(Bitmap::of(all), everyId), "Bitmap of a query result");
+}
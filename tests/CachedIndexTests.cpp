@@ -0,0 +1,105 @@
+#include "CachedIndex.h"
+#include "GridBucketing.h"
+#include "KDTree.h"
+#include "LearnedIndex.h"
+#include "TestSupport.h"
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace {
+struct Cacheable {
+    std::string name;
+    std::function<std::unique_ptr<DataStructure>()> make;
+};
+
+/// Zooms in on a window step by step, then repeats each step; checks answers and which lookups hit.
+void zoom(const std::string& name, const CachedIndex& cache, const Reference& reference, float centre) {
+    CacheStats before = cache.stats();
+    std::vector<RangeQuery> steps;
+    for (float width = 64; width >= 0.25f; width /= 2) steps.push_back({centre - width, centre + width});
+    for (const RangeQuery& w : steps) {
+        check(ids(cache.range_query_view(w.minRestEnergy, w.maxRestEnergy)) ==
+                  reference.range(w.minRestEnergy, w.maxRestEnergy),
+              name + " zoom to [" + std::to_string(w.minRestEnergy) + ", " + std::to_string(w.maxRestEnergy) + "]");
+    }
+    for (const RangeQuery& w : steps) {
+        check(ids(cache.range_query_view(w.minRestEnergy, w.maxRestEnergy)) ==
+                  reference.range(w.minRestEnergy, w.maxRestEnergy),
+              name + " repeat of [" + std::to_string(w.minRestEnergy) + ", " + std::to_string(w.maxRestEnergy) + "]");
+    }
+    CacheStats after = cache.stats();
+    check(after.misses - before.misses == 1, name + " zoom missed more than its first window");
+    check(after.contained - before.contained == steps.size() - 1, name + " zoom not answered from the first window");
+    check(after.hits - before.hits == steps.size(), name + " repeated windows not hit");
+}
+}
+
+/// Exact and containment hits over sorted and unsorted results, invalidation, and concurrent lookups.
+void testCachedIndex() {
+    std::vector<Cacheable> indexes = {
+        {"KDTree", [] { return std::make_unique<KDTree>(); }},
+        {"GridBucketing", [] { return std::make_unique<GridBucketing>(0.0f, 210.0f, 50); }},
+        {"LearnedIndex", [] { return std::make_unique<LearnedIndex>(16); }},
+    };
+    for (const Cacheable& candidate : indexes) {
+        std::string name = "CachedIndex over " + candidate.name;
+        std::mt19937 rng(43);
+        std::vector<CollisionEvent> events = randomEvents(rng, 5000);
+        Reference reference(events);
+        std::unique_ptr<DataStructure> index = candidate.make();
+        CachedIndex cache(*index, 64);
+        cache.build(events);
+        zoom(name, cache, reference, 91.0f);
+        compareQueries(name, cache, reference, rng);
+
+        // Every mutation clears the cache, so the next lookup sees it
+        for (int op = 0; op < 60; ++op) {
+            float centre = 20.0f + op % 5 * 10.0f;
+            cache.range_query_view(centre - 8, centre + 8);
+            CollisionEvent event = randomEvent(rng, op % 3 == 2 ? 6000 + op : op);
+            event.restEnergyOut = centre + (op % 7 - 3);
+            if (op % 3 == 0) {
+                check(cache.erase(op) == (reference.events.erase(op) == 1), name + " erase");
+            } else if (op % 3 == 1) {
+                bool stored = reference.events.count(op) == 1;
+                check(cache.update(event) == stored, name + " update");
+                if (stored) reference.events[op] = event;
+            } else {
+                cache.insert(event);
+                reference.events[event.eventId] = event;
+            }
+            check(ids(cache.range_query_view(centre - 4, centre + 4)) == reference.range(centre - 4, centre + 4),
+                  name + " lookup after mutation " + std::to_string(op));
+        }
+        zoom(name + " mutated", cache, reference, 40.0f);
+
+        // Concurrent lookups, some racing a clear(), all answer exactly
+        std::vector<std::thread> threads;
+        std::vector<int> wrong(4, 0);
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 local(t);
+                for (int q = 0; q < 200; ++q) {
+                    float lo = 30.0f + local() % 40, hi = lo + local() % 20;
+                    if (t == 0 && q % 20 == 0) cache.clear();
+                    wrong[t] += ids(cache.range_query_view(lo, hi)) != reference.range(lo, hi);
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+        for (int t = 0; t < 4; ++t) check(wrong[t] == 0, name + " concurrent lookups, thread " + std::to_string(t));
+    }
+
+    // Without capacity nothing is cached, but every answer is still exact
+    std::mt19937 rng(44);
+    std::vector<CollisionEvent> events = randomEvents(rng, 1000);
+    Reference reference(events);
+    KDTree tree;
+    CachedIndex uncached(tree, 0);
+    uncached.build(events);
+    compareQueries("CachedIndex without capacity", uncached, reference, rng, 10);
+    uncached.range_query_view(10, 20);
+    uncached.range_query_view(10, 20);
+    check(uncached.stats().hits == 0 && uncached.stats().contained == 0, "CachedIndex without capacity hit");
+}
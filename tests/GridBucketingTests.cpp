@@ -0,0 +1,55 @@
+#include "GridBucketing.h"
+#include "TestSupport.h"
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
+/// Adaptive boundaries under skewed inserts, with infinite keys among them, and range growth up to the largest floats.
+void testGridBucketing() {
+    std::mt19937 rng(8);
+    std::vector<CollisionEvent> events = randomEvents(rng, 2000);
+    Reference reference(events);
+    GridBucketing grid(0.0f, 210.0f, 30);
+    grid.adaptBoundaries(events);
+    grid.build(events);
+    compareQueries("GridBucketing adaptive", grid, reference, rng);
+
+    // A hot band splits; the piles of infinite keys in the outer cells must not
+    int nextId = 2000;
+    for (int i = 0; i < 6000; ++i) {
+        CollisionEvent event = randomEvent(rng, nextId++);
+        if (i % 3 == 0) event.restEnergyOut = 91.0f + (i % 500) / 100.0f;
+        if (i % 3 == 1) event.restEnergyOut = infinity;
+        if (i % 3 == 2) event.restEnergyOut = -infinity;
+        grid.insert(event);
+        reference.events[event.eventId] = event;
+    }
+    compareQueries("GridBucketing adaptive with hot cells and infinite keys", grid, reference, rng);
+
+    // Snapshots check that the boundaries ascend, so an edge at an infinite key would not restore
+    const std::string source = "grid_tests_source.bin", path = "grid_tests.snapshot";
+    std::ofstream(source) << "grid tests";
+    grid.save_snapshot(path, SnapshotSource::of(source));
+    GridBucketing restored(0.0f, 1.0f);
+    check(!rejects([&] { restored.load_snapshot(SnapshotImage(path, SnapshotSource::of(source))); }),
+          "GridBucketing adaptive snapshot with infinite keys rejected");
+    compareQueries("GridBucketing adaptive restored", restored, reference, rng, 10);
+
+    // Doubling the span toward the largest finite keys must stop at them, not overflow to infinity
+    GridBucketing growing(0.0f, 210.0f, 30);
+    Reference grown;
+    for (int i = 0; i < 3000; ++i) {
+        CollisionEvent event = randomEvent(rng, i);
+        if (i % 500 == 1) event.restEnergyOut = std::numeric_limits<float>::max() / (i % 3 + 1);
+        if (i % 500 == 2) event.restEnergyOut = std::numeric_limits<float>::lowest();
+        growing.insert(event);
+        grown.events[event.eventId] = event;
+    }
+    compareQueries("GridBucketing grown to the largest floats", growing, grown, rng);
+    growing.save_snapshot(path, SnapshotSource::of(source));
+    check(!rejects([&] { restored.load_snapshot(SnapshotImage(path, SnapshotSource::of(source))); }),
+          "GridBucketing grown to the largest floats: snapshot rejected");
+    compareQueries("GridBucketing grown to the largest floats, restored", restored, grown, rng, 10);
+    std::remove(source.c_str());
+    std::remove(path.c_str());
+}
@@ -0,0 +1,44 @@
+#include "LearnedIndex.h"
+#include "TestSupport.h"
+
+/// Trained model, insert buffer and retrain, for several error bounds, against the reference.
+void testLearnedIndex() {
+    for (size_t errorBound : {4, 32, 256}) {
+        std::mt19937 rng(static_cast<unsigned>(errorBound));
+        std::string name = "LearnedIndex(" + std::to_string(errorBound) + ")";
+        std::vector<CollisionEvent> events = randomEvents(rng, 5000);
+        Reference reference(events);
+        LearnedIndex index(errorBound);
+        index.build(events);
+        compareQueries(name + " built", index, reference, rng);
+
+        // Enough inserts to fill the buffer and force a retrain, checked on either side of it
+        for (int i = 0; i < 6000; ++i) {
+            CollisionEvent event = randomEvent(rng, 5000 + i);
+            index.insert(event);
+            reference.events[event.eventId] = event;
+            if (i == 100 || i == 4094 || i == 4095 || i == 5999) {
+                compareQueries(name + " after " + std::to_string(i + 1) + " inserts", index, reference, rng, 15);
+            }
+        }
+    }
+
+    // Infinite keys sit at the ends of the model; searches for them and past them must stay in range
+    std::mt19937 rng(7);
+    std::vector<CollisionEvent> events = randomEvents(rng, 2000);
+    for (size_t i = 0; i < 40; ++i) events[i].restEnergyOut = i % 2 ? infinity : -infinity;
+    Reference reference(events);
+    LearnedIndex index;
+    index.build(events);
+    compareQueries("LearnedIndex with infinite keys", index, reference, rng);
+    CollisionEvent event = randomEvent(rng, 2000);
+    event.restEnergyOut = infinity;
+    index.insert(event);
+    reference.events[event.eventId] = event;
+    compareQueries("LearnedIndex with an infinite key buffered", index, reference, rng);
+
+    LearnedIndex empty;
+    std::vector<CollisionEvent> none;
+    empty.build(none);
+    compareQueries("LearnedIndex empty", empty, Reference(), rng, 5);
+}
@@ -0,0 +1,105 @@
+#include "GridBucketing.h"
+#include "KDTree.h"
+#include "LearnedIndex.h"
+#include "StaticIndex.h"
+#include "TestSupport.h"
+#include <functional>
+#include <memory>
+
+namespace {
+struct Mutable {
+    std::string name;
+    std::function<std::unique_ptr<DataStructure>()> make;
+};
+
+/// Random inserts, erases and updates, including of absent ids, compared every few hundred operations.
+void mutateAndCompare(const std::string& name, DataStructure& index, Reference& reference, std::mt19937& rng,
+                      int operations, int& nextId) {
+    for (int op = 0; op < operations; ++op) {
+        int eventId = static_cast<int>(rng() % (nextId + 100));
+        switch (rng() % 3) {
+            case 0: {
+                CollisionEvent event = randomEvent(rng, nextId++);
+                index.insert(event);
+                reference.events[event.eventId] = event;
+                break;
+            }
+            case 1:
+                check(index.erase(eventId) == (reference.events.erase(eventId) == 1),
+                      name + " erase " + std::to_string(eventId));
+                break;
+            default: {
+                CollisionEvent event = randomEvent(rng, eventId);
+                bool stored = reference.events.count(eventId) == 1;
+                check(index.update(event) == stored, name + " update " + std::to_string(eventId));
+                if (stored) reference.events[eventId] = event;
+                break;
+            }
+        }
+        if (op % 500 == 499) compareQueries(name + " after " + std::to_string(op + 1) + " mutations", index, reference, rng, 10);
+    }
+}
+
+/// The KD-tree rebuilds once erased events pass a quarter of the live ones, or inserts double it.
+void testKDTreeRebuilds() {
+    std::mt19937 rng(2);
+    std::vector<CollisionEvent> events = randomEvents(rng, 4000);
+    Reference reference(events);
+    KDTree tree;
+    tree.build(events);
+
+    // 800 erased of 3200 live is exactly a quarter: marked in place, the leaves keep their size
+    size_t payload = tree.memory_usage().payload;
+    for (int eventId = 0; eventId < 800; ++eventId) {
+        tree.erase(eventId);
+        reference.events.erase(eventId);
+    }
+    check(tree.memory_usage().payload == payload, "KDTree rebuilt before a quarter of its events were erased");
+    compareQueries("KDTree at the erase threshold", tree, reference, rng);
+    tree.erase(800);
+    reference.events.erase(800);
+    check(tree.memory_usage().payload < payload, "KDTree not rebuilt past the erase threshold");
+    compareQueries("KDTree past the erase threshold", tree, reference, rng);
+
+    // Inserts, half into one narrow band, until the tree has more than doubled
+    for (int i = 0; i < 7000; ++i) {
+        CollisionEvent event = randomEvent(rng, 10000 + i);
+        if (i % 2) event.restEnergyOut = 91.0f + (i % 100) / 1000.0f;
+        tree.insert(event);
+        reference.events[event.eventId] = event;
+        if (i == 3198 || i == 3199 || i == 6999) {
+            compareQueries("KDTree after " + std::to_string(i + 1) + " inserts", tree, reference, rng, 10);
+        }
+    }
+}
+}
+
+/// Erase and update on every mutable index, through compaction, rebuild and retrain, down to empty.
+void testMutations() {
+    std::vector<Mutable> indexes = {
+        {"KDTree", [] { return std::make_unique<KDTree>(); }},
+        {"GridBucketing", [] { return std::make_unique<GridBucketing>(0.0f, 210.0f, 50); }},
+        {"GridBucketing 2-D", [] {
+             return std::make_unique<GridBucketing>(0.0f, 210.0f, 50, GridAxis::Multiplicity, 0.0f, 8.0f, 4);
+         }},
+        {"LearnedIndex", [] { return std::make_unique<LearnedIndex>(16); }},
+        {"StaticIndex", [] { return std::make_unique<StaticRangeIndex>(); }},
+    };
+    for (const Mutable& candidate : indexes) {
+        std::mt19937 rng(1);
+        std::vector<CollisionEvent> events = randomEvents(rng, 3000);
+        Reference reference(events);
+        std::unique_ptr<DataStructure> index = candidate.make();
+        index->build(events);
+        int nextId = 3000;
+        mutateAndCompare(candidate.name, *index, reference, rng, 3000, nextId);
+
+        for (auto it = reference.events.begin(); it != reference.events.end();) {
+            check(index->erase(it->first), candidate.name + " erase all");
+            it = reference.events.erase(it);
+        }
+        compareQueries(candidate.name + " emptied", *index, reference, rng, 5);
+        mutateAndCompare(candidate.name + " refilled", *index, reference, rng, 1000, nextId);
+    }
+    testKDTreeRebuilds();
+}
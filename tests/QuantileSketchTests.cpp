@@ -0,0 +1,111 @@
+#include "GridBucketing.h"
+#include "QuantileSketch.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <sstream>
+
+namespace {
+const double rankError = 0.02;  ///< Allowed rank error at the default k = 200, a margin over the expected 1.7/k.
+
+/// Every percentile of the sketch against the sorted values, allowing for ties.
+bool withinRankError(const QuantileSketch& sketch, std::vector<float> values) {
+    std::sort(values.begin(), values.end());
+    if (sketch.count() != values.size()) return false;
+    if (sketch.quantile(0) != values.front() || sketch.quantile(1) != values.back()) return false;
+    double n = static_cast<double>(values.size());
+    for (int percent = 1; percent < 100; ++percent) {
+        double q = percent / 100.0;
+        float value = sketch.quantile(q);
+        double below = (std::lower_bound(values.begin(), values.end(), value) - values.begin()) / n;
+        double atOrBelow = (std::upper_bound(values.begin(), values.end(), value) - values.begin()) / n;
+        if (q < below - rankError || q > atOrBelow + rankError) return false;
+        if (std::abs(sketch.rank(value) - atOrBelow) > rankError) return false;
+    }
+    return true;
+}
+
+std::vector<float> values(const Reference& reference, float lo, float hi, float CollisionEvent::*field) {
+    std::vector<float> result;
+    for (int eventId : reference.range(lo, hi)) result.push_back(reference.events.at(eventId).*field);
+    return result;
+}
+}
+
+/// KLL rank error over different streams, merging and serialisation, and the grid's per-cell sketches.
+void testQuantileSketch() {
+    std::mt19937 rng(45);
+    check(rejects([] { QuantileSketch().quantile(0.5); }), "QuantileSketch quantile of nothing");
+    std::gamma_distribution<float> skewed(2.0f, 20.0f);
+    for (size_t n : {1, 7, 200, 5000, 200000}) {
+        std::vector<float> stream;
+        for (size_t i = 0; i < n; ++i) stream.push_back(i % 10 == 0 ? std::round(skewed(rng)) : skewed(rng));
+        std::string name = "QuantileSketch over " + std::to_string(n);
+        QuantileSketch sketch;
+        for (float value : stream) sketch.add(value);
+        check(withinRankError(sketch, stream), name + " random values");
+        check(sketch.retained() <= std::max<size_t>(n, 3 * 200), name + " retained more than O(k) values");
+
+        // Sorted input is the adversarial order for compaction
+        std::vector<float> sorted = stream;
+        std::sort(sorted.begin(), sorted.end());
+        QuantileSketch ordered;
+        for (float value : sorted) ordered.add(value);
+        check(withinRankError(ordered, stream), name + " sorted values");
+
+        // Uneven pieces merged into one answer for the whole stream
+        QuantileSketch merged;
+        for (size_t first = 0, piece = 1; first < n; first += piece, piece = piece * 3 + 1) {
+            QuantileSketch part;
+            for (size_t i = first; i < std::min(n, first + piece); ++i) part.add(stream[i]);
+            merged.merge(part);
+        }
+        check(withinRankError(merged, stream), name + " merged pieces");
+
+        std::stringstream buffer;
+        sketch.write(buffer);
+        QuantileSketch restored = QuantileSketch::read(buffer);
+        std::vector<double> quartiles = {0, 0.25, 0.5, 0.75, 1};
+        check(restored.count() == n && restored.quantiles(quartiles) == sketch.quantiles(quartiles), name + " write/read");
+        std::stringstream whole;
+        sketch.write(whole);
+        std::stringstream truncated(whole.str().substr(0, whole.str().size() / 2));
+        check(rejects([&] { QuantileSketch::read(truncated); }), name + " truncated read");
+    }
+
+    // Grid sketches: covered cells merge theirs, cut cells and cells with tombstones are scanned
+    std::vector<CollisionEvent> events = randomEvents(rng, 40000);
+    Reference reference(events);
+    GridBucketing grid(0.0f, 210.0f, 30);
+    grid.build(events);
+    for (int round = 0; round < 3; ++round) {
+        for (int q = 0; q < 20; ++q) {
+            RangeQuery w = randomWindow(rng);
+            float lo = w.minRestEnergy, hi = w.maxRestEnergy;
+            std::string where = "GridBucketing sketches, round " + std::to_string(round) + " [" + std::to_string(lo) +
+                                ", " + std::to_string(hi) + "]";
+            std::vector<float> efficiencies = values(reference, lo, hi, &CollisionEvent::efficiency);
+            QuantileSketch efficiency = grid.efficiency_quantiles(lo, hi);
+            QuantileSketch restEnergy = grid.rest_energy_quantiles(lo, hi);
+            if (efficiencies.empty()) {
+                check(efficiency.count() == 0 && restEnergy.count() == 0, where + " of no events");
+                continue;
+            }
+            check(withinRankError(efficiency, efficiencies), where + " efficiency");
+            check(withinRankError(restEnergy, values(reference, lo, hi, &CollisionEvent::restEnergyOut)),
+                  where + " rest energy");
+        }
+        // Erase and update a few events per cell, short of compaction, so covered cells hold tombstones
+        for (int i = 0; i < 2000; ++i) {
+            int eventId = static_cast<int>(rng() % 40000);
+            if (!reference.events.count(eventId)) continue;
+            if (i % 2) {
+                grid.erase(eventId);
+                reference.events.erase(eventId);
+            } else {
+                CollisionEvent event = randomEvent(rng, eventId);
+                grid.update(event);
+                reference.events[eventId] = event;
+            }
+        }
+    }
+}
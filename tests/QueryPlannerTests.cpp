@@ -0,0 +1,86 @@
+#include "ColumnScan.h"
+#include "QueryPlanner.h"
+#include "TestSupport.h"
+
+namespace {
+/// Ids of the reference events passing the cut with restEnergyOut in the window.
+std::multiset<int> passing(const Reference& reference, const CompositionCut& cut, float lo, float hi) {
+    std::multiset<int> result;
+    for (int eventId : reference.range(lo, hi)) {
+        if (cut.matches(countParticles(reference.events.at(eventId).outgoingParticles))) result.insert(eventId);
+    }
+    return result;
+}
+
+/// composition_query() against the reference, whichever plan the planner picks.
+void compareCompositions(const std::string& name, const QueryPlanner& planner, const Reference& reference,
+                         std::mt19937& rng) {
+    for (int q = 0; q < 40; ++q) {
+        RangeQuery w = randomWindow(rng);
+        CompositionCut cut = randomCut(rng);
+        std::string where = name + " cut " + std::to_string(q) + " [" + std::to_string(w.minRestEnergy) + ", " +
+                            std::to_string(w.maxRestEnergy) + "] via " +
+                            planner.explain_composition(cut, w.minRestEnergy, w.maxRestEnergy);
+        check(ids(planner.composition_query(cut, w.minRestEnergy, w.maxRestEnergy)) ==
+                  passing(reference, cut, w.minRestEnergy, w.maxRestEnergy),
+              where);
+    }
+}
+}
+
+/// The column scan baseline, and the planner's plans and composition plans, against the reference.
+void testQueryPlanner() {
+    std::mt19937 rng(42);
+    std::vector<CollisionEvent> table = randomEvents(rng, 6000);
+    for (CollisionEvent& event : table) event.outgoingParticles = randomParticles(rng);
+    Reference reference(table);
+
+    ColumnScan scan;
+    std::vector<CollisionEvent> copy = table;
+    scan.build(copy);
+    compareQueries("ColumnScan", scan, reference, rng);
+
+    // The bitmap and signature indexes point into table; the planner gets a copy it may reorder
+    CompositionIndex bitmaps;
+    bitmaps.build(table);
+    SignatureIndex signatures;
+    signatures.build(table);
+    QueryPlanner planner(bitmaps, signatures);
+    copy = table;
+    planner.build(copy);
+    compareQueries("QueryPlanner", planner, reference, rng);
+    compareCompositions("QueryPlanner", planner, reference, rng);
+    check(planner.estimate_rows(-infinity, infinity) == table.size(), "QueryPlanner estimate of every row");
+
+    // Every plan must agree with the signature index, which the planner only uses unmodified
+    CompositionCut everything;
+    check(ids(planner.composition_query(everything, -infinity, infinity)) == reference.range(-infinity, infinity),
+          "QueryPlanner cut admitting every event");
+
+    // Once mutated, the bitmaps and signatures are stale; cuts test each event's own particles
+    int nextId = 6000;
+    for (int op = 0; op < 600; ++op) {
+        int eventId = static_cast<int>(rng() % nextId);
+        CollisionEvent event = randomEvent(rng, op % 2 ? eventId : nextId++);
+        event.outgoingParticles = randomParticles(rng);
+        if (op % 3 == 0) {
+            check(planner.erase(eventId) == (reference.events.erase(eventId) == 1), "QueryPlanner erase");
+        } else if (op % 2) {
+            bool stored = reference.events.count(eventId) == 1;
+            check(planner.update(event) == stored, "QueryPlanner update");
+            if (stored) reference.events[eventId] = event;
+        } else {
+            planner.insert(event);
+            reference.events[event.eventId] = event;
+        }
+    }
+    compareQueries("QueryPlanner mutated", planner, reference, rng);
+    compareCompositions("QueryPlanner mutated", planner, reference, rng);
+
+    check(rejects([&] { QueryPlanner(bitmaps, signatures, {}); }), "QueryPlanner over no access paths");
+    QueryPlanner single(bitmaps, signatures, {AccessKind::ColumnScan});
+    check(rejects([&] { single.range_query_view(0, 1); }), "QueryPlanner used before build()");
+    copy = table;
+    single.build(copy);
+    compareQueries("QueryPlanner over one path", single, Reference(table), rng, 10);
+}
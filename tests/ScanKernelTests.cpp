@@ -0,0 +1,39 @@
+#include "ScanKernels.h"
+#include "TestSupport.h"
+#include <cmath>
+
+/// selectInRange() against a scalar loop, over every length up to a few vectors and unaligned starts.
+void testScanKernels() {
+    std::mt19937 rng(50);
+    std::uniform_real_distribution<float> key(0.0f, 100.0f);
+    std::vector<float> keys(1100);
+    for (float& k : keys) {
+        switch (rng() % 20) {
+            case 0: k = std::numeric_limits<float>::quiet_NaN(); break;
+            case 1: k = rng() % 2 ? infinity : -infinity; break;
+            case 2: k = std::round(key(rng)); break;
+            default: k = key(rng);
+        }
+    }
+    std::vector<uint32_t> out(keys.size());
+    for (size_t count = 0; count <= 1024; count += count < 80 ? 1 : 37) {
+        size_t first = rng() % 16;
+        float minKey = std::round(key(rng)), maxKey = minKey + key(rng) / 2;
+        if (count % 13 == 0) {
+            minKey = -infinity;
+            maxKey = infinity;
+        }
+        std::vector<uint32_t> expected;
+        for (size_t i = 0; i < count; ++i) {
+            if (keys[first + i] >= minKey && keys[first + i] <= maxKey) expected.push_back(static_cast<uint32_t>(i));
+        }
+        size_t found = selectInRange(keys.data() + first, count, minKey, maxKey, out.data());
+        check(std::vector<uint32_t>(out.begin(), out.begin() + found) == expected,
+              std::string(scanKernelName()) + " selectInRange over " + std::to_string(count) + " keys");
+
+        std::vector<uint32_t> emitted;
+        forEachInRange(keys.data() + first, count, minKey, maxKey,
+                       [&](size_t i) { emitted.push_back(static_cast<uint32_t>(i)); });
+        check(emitted == expected, "forEachInRange over " + std::to_string(count) + " keys");
+    }
+}
@@ -0,0 +1,81 @@
+#include "SharedIndex.h"
+#include "TestSupport.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+const std::string segmentName = "/index_tests_shared";
+
+/// Windows from sorted key start to start + length, so they start and end inside, on and across block edges.
+std::vector<RangeQuery> blockWindows(const std::vector<CollisionEvent>& events) {
+    std::vector<float> keys;
+    for (const CollisionEvent& event : events) keys.push_back(event.restEnergyOut);
+    std::sort(keys.begin(), keys.end());
+    std::vector<RangeQuery> windows;
+    size_t block = SharedIndex::blockSize;
+    for (size_t start : {size_t(0), size_t(1), block - 1, block, block + 1, 3 * block - 5, keys.size() - block - 3}) {
+        for (size_t length : {size_t(0), size_t(1), block - 2, block - 1, block, block + 1, 2 * block, 5 * block + 7}) {
+            windows.push_back({keys[start], keys[std::min(keys.size() - 1, start + length)]});
+        }
+    }
+    return windows;
+}
+}
+
+/// Aggregates and top-k over partial blocks against a scan, and results that outlive the decoded cache.
+void testSharedIndex() {
+    const std::string source = "shared_tests_source.bin";
+    {
+        std::ofstream out(source, std::ios::binary | std::ios::trunc);
+        out << "shared index tests";
+    }
+    SnapshotSource identity = SnapshotSource::of(source);
+
+    // Not a multiple of the block size, so the last block is partial too
+    std::mt19937 rng(47);
+    std::vector<CollisionEvent> events = randomEvents(rng, 5000 + SharedIndex::blockSize / 2);
+    Reference reference(events);
+    std::unique_ptr<SharedSegment> segment = SharedIndex::publish(segmentName, events, identity);
+    const size_t decodedLimit = 4;
+    SharedIndex index(segmentName, identity, decodedLimit);
+    check(index.size() == events.size(), "SharedIndex size");
+
+    // Aggregates come from the columns and block aggregates without decoding a block
+    std::vector<RangeQuery> windows = blockWindows(events);
+    for (const RangeQuery& w : windows) {
+        float lo = w.minRestEnergy, hi = w.maxRestEnergy;
+        check(sameAggregate(index.aggregate(lo, hi), reference.aggregate(lo, hi)),
+              "SharedIndex aggregate [" + std::to_string(lo) + ", " + std::to_string(hi) + "]");
+    }
+    check(index.decoded_blocks() == 0, "SharedIndex aggregate decoded blocks");
+
+    for (const RangeQuery& w : windows) {
+        float lo = w.minRestEnergy, hi = w.maxRestEnergy;
+        for (size_t k : {1, 7, 64, 200, 100000}) {
+            check(efficiencies(index.top_k_in_range(k, lo, hi)) == reference.topK(k, lo, hi),
+                  "SharedIndex top " + std::to_string(k) + " in [" + std::to_string(lo) + ", " + std::to_string(hi) + "]");
+        }
+    }
+    compareQueries("SharedIndex", index, reference, rng);
+    check(index.decoded_blocks() <= decodedLimit, "SharedIndex cached more than its decode limit");
+
+    // Results pin their blocks, so they stay valid while later queries evict them from the cache
+    QueryResult everything = index.range_query_view(-infinity, infinity);
+    QueryResult best = index.top_k_in_range(100, 20.0f, 200.0f);
+    for (int q = 0; q < 50; ++q) {
+        float lo = static_cast<float>(rng() % 200);
+        index.range_query_view(lo, lo + 5);
+    }
+    check(index.decoded_blocks() <= decodedLimit, "SharedIndex cached more than its decode limit after eviction");
+    check(ids(everything) == reference.range(-infinity, infinity), "SharedIndex range result outliving its blocks");
+    check(efficiencies(best) == reference.topK(100, 20.0f, 200.0f), "SharedIndex top-k result outliving its blocks");
+
+    check(rejects([&] { index.insert(events[0]); }), "SharedIndex accepted an insert");
+    check(rejects([&] { index.erase(0); }), "SharedIndex accepted an erase");
+    check(rejects([&] { SharedIndex stale(segmentName, SnapshotSource{}); }), "SharedIndex attached to other data");
+
+    SharedSegment::remove(segmentName);
+    check(rejects([&] { SharedIndex missing(segmentName, identity); }), "SharedIndex attached to a removed segment");
+    std::remove(source.c_str());
+}
@@ -0,0 +1,75 @@
+#include "SignatureIndex.h"
+#include "TestSupport.h"
+
+namespace {
+std::vector<CollisionEvent> eventsWithParticles(std::mt19937& rng, size_t count) {
+    std::vector<CollisionEvent> events = randomEvents(rng, count);
+    for (CollisionEvent& event : events) event.outgoingParticles = randomParticles(rng);
+    return events;
+}
+
+/// Ids of the events passing match with restEnergyOut in the window.
+template <typename Match>
+std::multiset<int> scan(const std::vector<CollisionEvent>& events, Match match, float lo, float hi) {
+    std::multiset<int> result;
+    for (const CollisionEvent& event : events) {
+        if (event.restEnergyOut >= lo && event.restEnergyOut <= hi && match(countParticles(event.outgoingParticles)))
+            result.insert(event.eventId);
+    }
+    return result;
+}
+}
+
+/// Composition lookups, cuts and per-signature summaries against a scan of the table.
+void testSignatureIndex() {
+    std::mt19937 rng(38);
+    std::vector<CollisionEvent> events = eventsWithParticles(rng, 8000);
+    SignatureIndex index;
+    index.build(events);
+
+    size_t indexed = 0;
+    for (const Signature& group : index.signatures()) {
+        indexed += group.count;
+        auto same = [&](const ParticleCounts& counts) { return counts == group.counts; };
+        Aggregate expected;
+        for (const CollisionEvent& event : events) {
+            if (same(countParticles(event.outgoingParticles))) expected.add(event);
+        }
+        std::string name = "SignatureIndex " + signatureName(group.counts);
+        check(index.find(group.counts) == &group, name + " find");
+        check(sameAggregate(group.summary, expected), name + " summary");
+    }
+    check(indexed == events.size(), "SignatureIndex posting lists cover the table");
+    check(index.find(countParticles("tau,tau,tau,tau,tau,tau,tau")) == nullptr, "SignatureIndex unseen composition");
+
+    for (int q = 0; q < 80; ++q) {
+        RangeQuery w = randomWindow(rng);
+        float lo = w.minRestEnergy, hi = w.maxRestEnergy;
+        std::string where = " [" + std::to_string(lo) + ", " + std::to_string(hi) + "]";
+        ParticleCounts counts = countParticles(randomParticles(rng));
+        auto same = [&](const ParticleCounts& c) { return c == counts; };
+        check(ids(index.range_query(counts, lo, hi)) == scan(events, same, lo, hi),
+              "SignatureIndex composition " + signatureName(counts) + where);
+        CompositionCut cut = randomCut(rng);
+        auto passes = [&](const ParticleCounts& c) { return cut.matches(c); };
+        QueryResult result = index.range_query(cut, lo, hi);
+        check(ids(result) == scan(events, passes, lo, hi), "SignatureIndex cut " + std::to_string(q) + where);
+        // Results point into the table the index was built from
+        bool intoTable = true;
+        for (const CollisionEvent& event : result) {
+            intoTable &= &event >= events.data() && &event < events.data() + events.size();
+        }
+        check(intoTable, "SignatureIndex cut " + std::to_string(q) + " points into the table");
+    }
+
+    // A rebuild over a different table forgets the old one
+    std::vector<CollisionEvent> fewer = eventsWithParticles(rng, 50);
+    index.build(fewer);
+    auto any = [](const ParticleCounts&) { return true; };
+    check(ids(index.range_query(CompositionCut(), -infinity, infinity)) == scan(fewer, any, -infinity, infinity),
+          "SignatureIndex rebuilt over another table");
+    std::vector<CollisionEvent> none;
+    index.build(none);
+    check(index.signatures().empty() && index.range_query(CompositionCut(), -infinity, infinity).empty(),
+          "SignatureIndex built over no events");
+}
@@ -0,0 +1,137 @@
+#include "GridBucketing.h"
+#include "KDTree.h"
+#include "Snapshot.h"
+#include "TestSupport.h"
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <limits>
+
+namespace {
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+}
+
+/// Overwrites bytes of a snapshot in place, at offset into its index records.
+template <typename T>
+void patchRecords(const std::string& path, size_t offset, const T& value) {
+    SnapshotHeader header;
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    file.seekp(header.recordsOffset + offset);
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// Rewrites a snapshot's header in place.
+template <typename Edit>
+void patchHeader(const std::string& path, Edit edit) {
+    SnapshotHeader header;
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    edit(header);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+}
+
+/// Restored indexes answer as the saved ones did; corrupt or stale images are rejected.
+void testSnapshots() {
+    const std::string source = "snapshot_tests_source.bin", kdPath = "snapshot_tests_kd.snapshot",
+                      gridPath = "snapshot_tests_grid.snapshot";
+    writeFile(source, "index tests v1");
+    SnapshotSource identity = SnapshotSource::of(source);
+
+    std::mt19937 rng(46);
+    std::vector<CollisionEvent> events = randomEvents(rng, 5000);
+    Reference reference(events);
+    KDTree tree;
+    GridBucketing grid(0.0f, 210.0f, 50);
+    {
+        std::vector<CollisionEvent> copy = events;
+        tree.build(copy);
+        grid.build(events);
+    }
+    // Erased events are left out of the image
+    for (int eventId = 0; eventId < 500; eventId += 3) {
+        tree.erase(eventId);
+        grid.erase(eventId);
+        reference.events.erase(eventId);
+    }
+    tree.save_snapshot(kdPath, identity);
+    grid.save_snapshot(gridPath, identity);
+
+    KDTree restoredTree;
+    GridBucketing restoredGrid(0.0f, 1.0f);
+    restoredTree.load_snapshot(SnapshotImage(kdPath, identity));
+    restoredGrid.load_snapshot(SnapshotImage(gridPath, identity));
+    compareQueries("KDTree restored", restoredTree, reference, rng);
+    compareQueries("GridBucketing restored", restoredGrid, reference, rng);
+    // Restored indexes stay mutable
+    for (int eventId = 1000; eventId < 1100; ++eventId) {
+        restoredTree.erase(eventId);
+        restoredGrid.erase(eventId);
+        reference.events.erase(eventId);
+    }
+    compareQueries("KDTree restored and mutated", restoredTree, reference, rng, 10);
+    compareQueries("GridBucketing restored and mutated", restoredGrid, reference, rng, 10);
+
+    check(rejects([&] { GridBucketing other(0.0f, 1.0f); other.load_snapshot(SnapshotImage(kdPath, identity)); }),
+          "GridBucketing accepted a KDTree snapshot");
+    check(rejects([&] { KDTree other; other.load_snapshot(SnapshotImage(gridPath, identity)); }),
+          "KDTree accepted a GridBucketing snapshot");
+
+    // A bad grid layout is rejected before the grid changes: bucketRange is the record's third float
+    Reference before = reference;
+    patchRecords(gridPath, 2 * sizeof(float), std::numeric_limits<float>::quiet_NaN());
+    check(rejects([&] { restoredGrid.load_snapshot(SnapshotImage(gridPath, identity)); }),
+          "GridBucketing accepted a NaN cell width");
+    compareQueries("GridBucketing after a rejected layout", restoredGrid, before, rng, 10);
+
+    // A cell claiming more events than the image holds; the first cell count follows the 64-byte grid record
+    grid.save_snapshot(gridPath, identity);
+    patchRecords(gridPath, 64, std::numeric_limits<uint64_t>::max());
+    check(rejects([&] { restoredGrid.load_snapshot(SnapshotImage(gridPath, identity)); }),
+          "GridBucketing accepted an oversized cell");
+    check(restoredGrid.aggregate(-infinity, infinity).count == 0, "GridBucketing kept part of a rejected snapshot");
+
+    // Header sizes chosen so that offset + size, or count * record size, wraps past 2^64 to a small value
+    std::vector<std::pair<std::string, std::function<void(SnapshotHeader&)>>> wrapping = {
+        // Event records are a multiple of four bytes, so 2^62 of them wrap to zero bytes
+        {"event count", [](SnapshotHeader& h) { h.eventCount = uint64_t(1) << 62; }},
+        {"string pool size", [](SnapshotHeader& h) { h.stringsSize = 0 - h.stringsOffset; }},
+        {"record size", [](SnapshotHeader& h) { h.recordsSize = 0 - h.recordsOffset; }},
+        {"section order", [](SnapshotHeader& h) { h.stringsOffset = h.eventsOffset - 1; }},
+        {"event offset", [](SnapshotHeader& h) { h.eventsOffset = 0; }},
+    };
+    for (const auto& patch : wrapping) {
+        tree.save_snapshot(kdPath, identity);
+        patchHeader(kdPath, patch.second);
+        check(rejects([&] { SnapshotImage image(kdPath, identity); }), "SnapshotImage accepted a wrapping " + patch.first);
+    }
+
+    // Record counts and offsets from inside the image cannot wrap view() or read() either
+    tree.save_snapshot(kdPath, identity);
+    {
+        SnapshotImage image(kdPath, identity);
+        size_t max = std::numeric_limits<size_t>::max();
+        check(rejects([&] { image.view<uint64_t>(0, max / sizeof(uint64_t) + 2); }), "SnapshotImage viewed a wrapping count");
+        check(rejects([&] { image.view<uint64_t>(max - 7, 1); }), "SnapshotImage viewed at a wrapping offset");
+        size_t offset = max - 3;
+        check(rejects([&] { image.read<uint64_t>(offset); }), "SnapshotImage read at a wrapping offset");
+    }
+
+    // Truncated or extended images fail their size check, and a changed data file makes them stale
+    {
+        std::ofstream out(kdPath, std::ios::binary | std::ios::app);
+        out << 'x';
+    }
+    check(rejects([&] { SnapshotImage image(kdPath, identity); }), "SnapshotImage accepted a resized file");
+    tree.save_snapshot(kdPath, identity);
+    writeFile(source, "index tests v2");
+    check(rejects([&] { SnapshotImage image(kdPath, SnapshotSource::of(source)); }), "SnapshotImage accepted a stale snapshot");
+
+    std::remove(source.c_str());
+    std::remove(kdPath.c_str());
+    std::remove(gridPath.c_str());
+}
@@ -0,0 +1,74 @@
+#include "StaticIndex.h"
+#include "TestSupport.h"
+#include <algorithm>
+
+namespace {
+/// Leaf searches against std::lower_bound/upper_bound over the sorted keys, padding included.
+template <size_t LeafSize>
+void compareBounds(std::mt19937& rng, size_t count) {
+    std::vector<CollisionEvent> events = randomEvents(rng, count);
+    if (count > 2) events[0].restEnergyOut = infinity, events[1].restEnergyOut = -infinity;
+    StaticIndex<RestEnergyKey, LeafSize> index;
+    index.build(events);
+    std::vector<float> keys;
+    for (const CollisionEvent& event : events) keys.push_back(event.restEnergyOut);
+    std::sort(keys.begin(), keys.end());
+    std::string name = "StaticIndex<" + std::to_string(LeafSize) + "> over " + std::to_string(count);
+    for (int q = 0; q < 200; ++q) {
+        float key = q % 4 == 0 && count ? keys[rng() % count] : randomWindow(rng).minRestEnergy;
+        if (q == 1) key = infinity;
+        if (q == 2) key = -infinity;
+        size_t lower = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+        size_t upper = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+        check(index.lowerBound(key) == lower, name + " lowerBound " + std::to_string(key));
+        check(index.upperBound(key) == upper, name + " upperBound " + std::to_string(key));
+    }
+}
+}
+
+/// Leaf searches, and the adapter's insert buffer and erase flags up to the thresholds that rebuild it.
+void testStaticIndex() {
+    std::mt19937 rng(41);
+    for (size_t count : {0, 1, 15, 16, 17, 1000}) {
+        compareBounds<1>(rng, count);
+        compareBounds<16>(rng, count);
+    }
+
+    std::vector<CollisionEvent> events = randomEvents(rng, 4000);
+    Reference reference(events);
+    IndexAdapter<StaticIndex<RestEnergyKey, 4>> small;
+    std::vector<CollisionEvent> copy = events;
+    small.build(copy);
+    compareQueries("StaticIndex with 4-key leaves", small, reference, rng);
+
+    StaticRangeIndex index;
+    index.build(events);
+    size_t leaves = index.leafCount();
+    // 4095 buffered inserts leave the layout alone; the 4096th rebuilds it with all of them
+    for (int i = 0; i < 4095; ++i) {
+        CollisionEvent event = randomEvent(rng, 4000 + i);
+        index.insert(event);
+        reference.events[event.eventId] = event;
+    }
+    check(index.leafCount() == leaves, "StaticIndex rebuilt before its insert buffer filled");
+    compareQueries("StaticIndex with a full insert buffer", index, reference, rng);
+    CollisionEvent last = randomEvent(rng, 8095);
+    index.insert(last);
+    reference.events[last.eventId] = last;
+    check(index.leafCount() == 8096 / 16, "StaticIndex not rebuilt when its insert buffer filled");
+    compareQueries("StaticIndex after merging its insert buffer", index, reference, rng);
+
+    // An eighth of the rows erased is flagged in place; one more drops them all
+    leaves = index.leafCount();
+    for (int eventId = 0; eventId < 1012; ++eventId) {
+        check(index.erase(eventId), "StaticIndex erase " + std::to_string(eventId));
+        reference.events.erase(eventId);
+    }
+    check(!index.erase(0) && !index.update(randomEvent(rng, 0)), "StaticIndex erase of an erased event");
+    check(index.leafCount() == leaves, "StaticIndex rebuilt before an eighth of its rows were erased");
+    compareQueries("StaticIndex at the erase threshold", index, reference, rng);
+    index.erase(1012);
+    reference.events.erase(1012);
+    check(index.leafCount() == (8096 - 1013 + 15) / 16, "StaticIndex not rebuilt past the erase threshold");
+    compareQueries("StaticIndex past the erase threshold", index, reference, rng);
+}
@@ -0,0 +1,22 @@
+#include "TestSupport.h"
+#include <cstdio>
+
+int main() {
+    testLearnedIndex();
+    testMutations();
+    testBatches();
+    testGridBucketing();
+    testBitmaps();
+    testSignatureIndex();
+    testStaticIndex();
+    testQueryPlanner();
+    testCachedIndex();
+    testApproximateIndex();
+    testQuantileSketch();
+    testSnapshots();
+    testSharedIndex();
+    testArena();
+    testScanKernels();
+    std::printf("%d failed checks\n", failureCount());
+    return failureCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include "TestSupport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+int failures = 0;
+
+bool close(double a, double b) {
+    if (a == b || (std::isnan(a) && std::isnan(b))) return true;
+    return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::fabs(b));
+}
+
+bool inWindow(const CollisionEvent& event, float minRestEnergy, float maxRestEnergy) {
+    return event.restEnergyOut >= minRestEnergy && event.restEnergyOut <= maxRestEnergy;
+}
+}
+
+void check(bool condition, const std::string& what) {
+    if (condition) return;
+    std::printf("FAIL: %s\n", what.c_str());
+    ++failures;
+}
+
+int failureCount() {
+    return failures;
+}
+
+CollisionEvent randomEvent(std::mt19937& rng, int eventId) {
+    std::gamma_distribution<float> restEnergy(2.0f, 20.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+    CollisionEvent event;
+    event.eventId = eventId;
+    event.incomingParticles = "proton,proton";
+    event.outgoingParticles = rng() % 2 ? "muon,muon" : "electron,jet,jet";
+    event.kineticEnergyIn = 13000;
+    event.restEnergyOut = restEnergy(rng);
+    if (rng() % 10 == 0) event.restEnergyOut = std::round(event.restEnergyOut);
+    event.efficiency = event.restEnergyOut / event.kineticEnergyIn * scale(rng);
+    return event;
+}
+
+std::vector<CollisionEvent> randomEvents(std::mt19937& rng, size_t count) {
+    std::vector<CollisionEvent> events;
+    for (size_t i = 0; i < count; ++i) events.push_back(randomEvent(rng, static_cast<int>(i)));
+    return events;
+}
+
+std::string randomParticles(std::mt19937& rng) {
+    std::string particles;
+    for (int n = rng() % 7; n > 0; --n) {
+        if (!particles.empty()) particles += ",";
+        particles += particleName(static_cast<ParticleType>(rng() % NumParticleTypes));
+    }
+    return particles;
+}
+
+CompositionCut randomCut(std::mt19937& rng) {
+    CompositionCut cut;
+    for (int t = 0; t < NumParticleTypes; ++t) {
+        if (rng() % 3 == 0) cut.atLeast(static_cast<ParticleType>(t), rng() % 3);
+        if (rng() % 3 == 0) cut.atMost(static_cast<ParticleType>(t), rng() % 4);
+    }
+    return cut;
+}
+
+RangeQuery randomWindow(std::mt19937& rng) {
+    std::uniform_real_distribution<float> key(-10.0f, 250.0f), width(0.0f, 80.0f);
+    float minRest = key(rng);
+    switch (rng() % 8) {
+        case 0: return {-infinity, infinity};
+        case 1: return {minRest, infinity};
+        case 2: return {minRest, minRest - 1};
+        case 3: return {std::round(minRest), std::round(minRest)};
+        default: return {minRest, minRest + width(rng)};
+    }
+}
+
+Reference::Reference(const std::vector<CollisionEvent>& initial) {
+    for (const CollisionEvent& event : initial) events[event.eventId] = event;
+}
+
+std::multiset<int> Reference::range(float minRestEnergy, float maxRestEnergy) const {
+    std::multiset<int> result;
+    for (const auto& entry : events) {
+        if (inWindow(entry.second, minRestEnergy, maxRestEnergy)) result.insert(entry.first);
+    }
+    return result;
+}
+
+std::vector<float> Reference::topK(size_t k, float minRestEnergy, float maxRestEnergy) const {
+    std::vector<float> best;
+    for (const auto& entry : events) {
+        if (inWindow(entry.second, minRestEnergy, maxRestEnergy)) best.push_back(entry.second.efficiency);
+    }
+    std::sort(best.rbegin(), best.rend());
+    if (best.size() > k) best.resize(k);
+    return best;
+}
+
+Aggregate Reference::aggregate(float minRestEnergy, float maxRestEnergy) const {
+    Aggregate result;
+    for (const auto& entry : events) {
+        if (inWindow(entry.second, minRestEnergy, maxRestEnergy)) result.add(entry.second);
+    }
+    return result;
+}
+
+std::multiset<int> ids(const QueryResult& result) {
+    std::multiset<int> eventIds;
+    for (const CollisionEvent& event : result) eventIds.insert(event.eventId);
+    return eventIds;
+}
+
+std::vector<float> efficiencies(const QueryResult& result) {
+    std::vector<float> values;
+    for (const CollisionEvent& event : result) values.push_back(event.efficiency);
+    return values;
+}
+
+bool sameAggregate(const Aggregate& a, const Aggregate& b) {
+    if (a.count != b.count) return false;
+    if (a.count == 0) return true;
+    return close(a.sumEfficiency, b.sumEfficiency) && close(a.sumRestEnergy, b.sumRestEnergy) &&
+           a.minEfficiency == b.minEfficiency && a.maxEfficiency == b.maxEfficiency &&
+           a.minRestEnergy == b.minRestEnergy && a.maxRestEnergy == b.maxRestEnergy;
+}
+
+void compareQueries(const std::string& name, const DataStructure& index, const Reference& reference,
+                    std::mt19937& rng, int windows) {
+    for (int q = 0; q < windows; ++q) {
+        RangeQuery w = randomWindow(rng);
+        float lo = w.minRestEnergy, hi = w.maxRestEnergy;
+        std::string where = name + " [" + std::to_string(lo) + ", " + std::to_string(hi) + "]";
+        check(ids(index.range_query_view(lo, hi)) == reference.range(lo, hi), where + " range_query_view");
+        size_t k = 1 + rng() % 50;
+        check(efficiencies(index.top_k_in_range(k, lo, hi)) == reference.topK(k, lo, hi), where + " top_k_in_range");
+        check(sameAggregate(index.aggregate(lo, hi), reference.aggregate(lo, hi)), where + " aggregate");
+    }
+    check(efficiencies(index.top_k(10)) == reference.topK(10, -infinity, infinity), name + " top_k");
+    if (reference.events.empty()) {
+        check(rejects([&] { index.find_max_efficiency(); }), name + " find_max_efficiency on no events");
+    } else {
+        float best = -infinity;
+        bool threw = rejects([&] { best = index.find_max_efficiency().efficiency; });
+        check(!threw && best == reference.topK(1, -infinity, infinity)[0], name + " find_max_efficiency");
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include "CompositionIndex.h"
+#include "DataStructure.h"
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @file TestSupport.h
+ * @brief Brute-force reference and random inputs shared by the index tests.
+ *
+ * Every test drives a structure with random data and windows and compares its
+ * answers with a plain scan of the same events (Reference). check() records a
+ * failure and carries on, so one run reports every mismatch; the test binary
+ * exits non-zero if any check failed. Seeds are fixed, so a failure
+ * reproduces.
+ */
+
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+/// Records a failed check, printing what was being checked.
+void check(bool condition, const std::string& what);
+int failureCount();
+
+/// Rest energies follow a gamma distribution like the ATLAS data; every tenth is rounded, so keys repeat.
+CollisionEvent randomEvent(std::mt19937& rng, int eventId);
+/// count events with ids 0 to count - 1.
+std::vector<CollisionEvent> randomEvents(std::mt19937& rng, size_t count);
+/// Up to six comma-separated species, so compositions repeat but vary.
+std::string randomParticles(std::mt19937& rng);
+/// Random lower and upper bounds on some species, sometimes contradictory.
+CompositionCut randomCut(std::mt19937& rng);
+/// A random window over the data, sometimes empty, inverted, a single key or unbounded.
+RangeQuery randomWindow(std::mt19937& rng);
+
+/**
+ * @struct Reference
+ * @brief The stored events by eventId, queried by scanning them all.
+ */
+struct Reference {
+    std::map<int, CollisionEvent> events;
+
+    explicit Reference(const std::vector<CollisionEvent>& initial = {});
+    std::multiset<int> range(float minRestEnergy, float maxRestEnergy) const;
+    /// Efficiencies of the k best events in the window, best first.
+    std::vector<float> topK(size_t k, float minRestEnergy, float maxRestEnergy) const;
+    Aggregate aggregate(float minRestEnergy, float maxRestEnergy) const;
+};
+
+std::multiset<int> ids(const QueryResult& result);
+/// Efficiencies in result order; ties make the events themselves ambiguous.
+std::vector<float> efficiencies(const QueryResult& result);
+/// Equal counts and extrema, and sums equal up to summation order.
+bool sameAggregate(const Aggregate& a, const Aggregate& b);
+
+/// Range, top-k and aggregate queries over random windows, plus top_k() and find_max_efficiency().
+void compareQueries(const std::string& name, const DataStructure& index, const Reference& reference,
+                    std::mt19937& rng, int windows = 40);
+
+/// True if load throws std::runtime_error.
+template <typename Load>
+bool rejects(Load load) {
+    try {
+        load();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Test groups, one per file
+void testLearnedIndex();
+void testMutations();
+void testBatches();
+void testGridBucketing();
+void testBitmaps();
+void testSignatureIndex();
+void testStaticIndex();
+void testQueryPlanner();
+void testCachedIndex();
+void testApproximateIndex();
+void testQuantileSketch();
+void testSnapshots();
+void testSharedIndex();
+void testArena();
+void testScanKernels();
+
+#endif // TEST_SUPPORT_H